@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// blocking fifo with a fixed capacity, Push waits while full (backpressure)
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    // false if the queue has been closed
+    bool Push(T value)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+
+        items.push_back(std::move(value));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // false once the queue is closed and drained
+    bool Pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+
+        value = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return items.size();
+    }
+
+private:
+    const size_t capacity;
+
+    mutable std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    bool closed = false;
+};
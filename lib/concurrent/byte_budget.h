@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+
+// counting semaphore over bytes, Acquire waits while the budget is used up.
+// a request larger than the whole budget still runs, but alone
+class ByteBudget
+{
+public:
+    explicit ByteBudget(size_t limit)
+        : limit(limit)
+    {
+    }
+
+    void Acquire(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        released.wait(lock, [this, bytes]() { return used == 0 || used + bytes <= limit; });
+        used += bytes;
+    }
+
+    void Release(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        used -= bytes;
+        released.notify_all();
+    }
+
+private:
+    const size_t limit;
+    size_t used = 0;
+
+    std::mutex mtx;
+    std::condition_variable released;
+};
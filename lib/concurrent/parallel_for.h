@@ -0,0 +1,38 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+inline int ThreadCount()
+{
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+// split [begin, end) into at most max_chunks contiguous ranges,
+// func(chunk_begin, chunk_end, chunk_id) runs once per range
+template <typename Func>
+void ParallelFor(size_t begin, size_t end, const Func& func, int max_chunks = ThreadCount())
+{
+    if (end <= begin)
+        return;
+
+    const size_t count = end - begin;
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(max_chunks, count));
+    const size_t step = (count + chunks - 1) / chunks;
+
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        const size_t b = begin + c * step;
+        const size_t e = std::min(end, b + step);
+        if (b >= e)
+            break;
+        workers.emplace_back([&func, b, e, c]() { func(b, e, static_cast<int>(c)); });
+    }
+
+    func(begin, std::min(end, begin + step), 0);
+
+    for (auto& worker : workers)
+        worker.join();
+}
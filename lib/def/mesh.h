@@ -0,0 +1,9 @@
+#pragma once
+#include "def/model.h"
+#include <Eigen/Core>
+
+struct Mesh
+{
+    Model vertex;
+    std::vector<Eigen::Vector3i> face; // vertex index, facing the camera
+};
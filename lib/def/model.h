@@ -1,4 +1,5 @@
 #pragma once
+#include "profiling/tracked_allocator.h"
 #include <vector>
 #include <Eigen/Core>
 
@@ -13,4 +14,5 @@ struct ModelVertex
     ModelColor color;
 };
 
-using Model = std::vector<ModelVertex>;
\ No newline at end of file
+// counted under MemoryTracker::MODEL
+using Model = std::vector<ModelVertex, TrackedAllocator<ModelVertex, MemoryTracker::MODEL>>;
\ No newline at end of file
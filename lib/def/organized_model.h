@@ -0,0 +1,48 @@
+#pragma once
+#include "def/model.h"
+
+// model that keeps the image grid, vertex (u, v) is at v * width + u
+struct OrganizedModel
+{
+    int width = 0, height = 0;
+    Model vertex;
+    std::vector<unsigned char> valid;
+    std::vector<Eigen::Vector3d> normal; // empty until computed
+
+    void Resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        vertex.assign(static_cast<size_t>(w) * h, ModelVertex{Eigen::Vector3d::Zero(), {0, 0, 0}});
+        valid.assign(static_cast<size_t>(w) * h, 0);
+        normal.clear();
+    }
+
+    bool Inside(int u, int v) const { return u >= 0 && v >= 0 && u < width && v < height; }
+    bool Valid(int u, int v) const { return Inside(u, v) && valid[Index(u, v)]; }
+    size_t Index(int u, int v) const { return static_cast<size_t>(v) * width + u; }
+
+    const ModelVertex& At(int u, int v) const { return vertex[Index(u, v)]; }
+    ModelVertex& At(int u, int v) { return vertex[Index(u, v)]; }
+
+    size_t ValidCount() const
+    {
+        size_t count = 0;
+        for (auto flag : valid)
+            count += flag != 0;
+        return count;
+    }
+
+    // unordered model of the valid vertex
+    Model ToModel() const
+    {
+        Model model;
+        model.reserve(ValidCount());
+        for (size_t i = 0; i < vertex.size(); ++i)
+        {
+            if (valid[i])
+                model.push_back(vertex[i]);
+        }
+        return model;
+    }
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <Eigen/Core>
+
+struct PinholeCamera
+{
+    double fx, fy, cx, cy;
+
+    Eigen::Vector3d BackProject(double u, double v, double depth) const
+    {
+        return Eigen::Vector3d((u - cx) * depth / fx, (v - cy) * depth / fy, depth);
+    }
+
+    Eigen::Vector2d Project(const Eigen::Vector3d& pos) const
+    {
+        return Eigen::Vector2d(pos.x() * fx / pos.z() + cx, pos.y() * fy / pos.z() + cy);
+    }
+};
@@ -9,6 +9,18 @@ struct WinBoundary
     {
     }
 
+    void Extend(const Eigen::Vector3d& pos)
+    {
+        wmin = wmin.cwiseMin(pos);
+        wmax = wmax.cwiseMax(pos);
+    }
+
+    void Extend(const WinBoundary& other)
+    {
+        wmin = wmin.cwiseMin(other.wmin);
+        wmax = wmax.cwiseMax(other.wmax);
+    }
+
     Eigen::Vector3d wmin;
     Eigen::Vector3d wmax;
 };
@@ -0,0 +1,97 @@
+#include "frame_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+FrameStats::FrameStats(size_t capacity)
+    : samples(std::max<size_t>(1, capacity))
+{
+}
+
+void FrameStats::Add(const FrameSample& sample)
+{
+    samples[head] = sample;
+    head = (head + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+}
+
+void FrameStats::Clear()
+{
+    head = 0;
+    count = 0;
+}
+
+const FrameSample& FrameStats::At(size_t i) const
+{
+    return samples[(head + samples.size() - count + i) % samples.size()];
+}
+
+double FrameStats::MeanCpuMs() const
+{
+    if (count == 0)
+        return 0.0;
+
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+        sum += At(i).cpu_ms;
+    return sum / count;
+}
+
+double FrameStats::MeanGpuMs() const
+{
+    double sum = 0.0;
+    size_t gpu_count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (At(i).gpu_ms < 0)
+            continue;
+        sum += At(i).gpu_ms;
+        ++gpu_count;
+    }
+    return gpu_count ? sum / gpu_count : -1.0;
+}
+
+double FrameStats::CpuPercentileMs(double p) const
+{
+    if (count == 0)
+        return 0.0;
+
+    std::vector<double> cpu(count);
+    for (size_t i = 0; i < count; ++i)
+        cpu[i] = At(i).cpu_ms;
+
+    const size_t k = std::min(count - 1, static_cast<size_t>(std::lround(std::max(0.0, std::min(1.0, p)) * (count - 1))));
+    std::nth_element(cpu.begin(), cpu.begin() + k, cpu.end());
+    return cpu[k];
+}
+
+std::vector<int> FrameStats::CpuHistogram(double bin_ms, int bins) const
+{
+    std::vector<int> hist(std::max(1, bins), 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int bin = static_cast<int>(At(i).cpu_ms / bin_ms);
+        ++hist[std::min(std::max(bin, 0), static_cast<int>(hist.size()) - 1)];
+    }
+    return hist;
+}
+
+bool FrameStats::WriteCsv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << path << ": open fail\n";
+        return false;
+    }
+
+    file << "frame,cpu_ms,gpu_ms,points,pick_ms\n";
+    for (size_t i = 0; i < count; ++i)
+    {
+        const FrameSample& s = At(i);
+        file << s.frame << ',' << s.cpu_ms << ',' << s.gpu_ms << ','
+             << s.points << ',' << s.pick_ms << '\n';
+    }
+    return static_cast<bool>(file);
+}
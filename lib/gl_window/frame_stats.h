@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one redisplay of GlWindow, -1 where the driver gave no timer or primitive query
+struct FrameSample
+{
+    int64_t frame = 0;
+    double cpu_ms = 0.0;  // DisplayFunc, overlay excluded
+    double gpu_ms = -1.0; // GL_TIME_ELAPSED around the scene
+    int64_t points = -1;  // GL_PRIMITIVES_GENERATED by the draw frame func
+    double pick_ms = 0.0; // rect box / curve picking since the previous frame
+};
+
+// the last capacity frames, oldest overwritten first
+class FrameStats
+{
+public:
+    explicit FrameStats(size_t capacity = 600);
+
+    void Add(const FrameSample& sample);
+    void Clear();
+
+    size_t Size() const { return count; }
+    // i = 0 is the oldest kept frame
+    const FrameSample& At(size_t i) const;
+    const FrameSample& Latest() const { return At(count - 1); }
+
+    double MeanCpuMs() const;
+    double MeanGpuMs() const; // -1 without any gpu sample
+    // p in [0, 1] over the kept cpu times
+    double CpuPercentileMs(double p) const;
+
+    // cpu times in bins of bin_ms, the last bin also counts everything slower
+    std::vector<int> CpuHistogram(double bin_ms, int bins) const;
+
+    // frame,cpu_ms,gpu_ms,points,pick_ms, oldest first
+    bool WriteCsv(const std::string& path) const;
+
+private:
+    std::vector<FrameSample> samples;
+    size_t head = 0; // next slot to write
+    size_t count = 0;
+};
@@ -1,8 +1,13 @@
+// query objects are gl 3.x entry points
+#define GL_GLEXT_PROTOTYPES
 #include "gl_window.h"
 #include "fnptr.h"
 #include "math/quadric_surface.h"
 #include "math/tk_spline.h"
+#include "profiling/trace.h"
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <numeric>
 
@@ -11,6 +16,11 @@ namespace
 
 using VertexSet = std::vector<Eigen::Vector3d>;
 
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 VertexSet PreProcessCurve(const VertexSet& curve_vertex)
 {
     if (curve_vertex.size() <= 3)
@@ -182,6 +192,134 @@ void GlWindow::InitGL(const std::string& window_name)
     GLfloat light0_position[] = {0, 1, 0, 1.0};
     glLightfv(GL_LIGHT0, GL_POSITION, light0_position);
     glEnable(GL_LIGHT0);
+
+    InitFrameQueries();
+}
+
+void GlWindow::InitFrameQueries()
+{
+    int major = 0, minor = 0;
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    if (version)
+        sscanf(version, "%d.%d", &major, &minor);
+
+    primitive_query = major >= 3;
+    timer_query = major > 3 || (major == 3 && minor >= 3) || glutExtensionSupported("GL_ARB_timer_query");
+    if (primitive_query || timer_query)
+        glGenQueries(query_slots * 2, &frame_queries[0][0]);
+    else
+        std::cout << "gl " << (version ? version : "?") << ": no gpu time or points drawn in frame stats\n";
+}
+
+static bool QueryAvailable(GLuint query)
+{
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+void GlWindow::CollectFrameSamples(int64_t force_before)
+{
+    for (; collect_index < frame_index; ++collect_index)
+    {
+        const int slot = collect_index % query_slots;
+        FrameSample& sample = slot_samples[slot];
+        const bool timed = timer_query && QueryAvailable(frame_queries[slot][0]);
+        const bool counted = sample.points >= 0 && QueryAvailable(frame_queries[slot][1]);
+        const bool done = timed == timer_query && counted == (sample.points >= 0);
+
+        // frames still on the gpu wait for a later DisplayFunc, unless their slot is due for reuse
+        if (!done && collect_index >= force_before)
+            break;
+
+        if (timed)
+        {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(frame_queries[slot][0], GL_QUERY_RESULT, &elapsed_ns);
+            sample.gpu_ms = elapsed_ns / 1e6;
+        }
+        if (counted)
+        {
+            GLuint primitives = 0;
+            glGetQueryObjectuiv(frame_queries[slot][1], GL_QUERY_RESULT, &primitives);
+            sample.points = primitives;
+        }
+        else
+        {
+            sample.points = -1;
+        }
+
+        frame_stats.Add(sample);
+    }
+}
+
+void GlWindow::DrawStatsOverlay()
+{
+    if (frame_stats.Size() == 0)
+        return;
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, win_width, 0, win_height);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_CULL_FACE);
+
+    const FrameSample& last = frame_stats.Latest();
+    char lines[4][96];
+    snprintf(lines[0], sizeof(lines[0]), "cpu  %6.2f ms  mean %6.2f  p95 %6.2f",
+             last.cpu_ms, frame_stats.MeanCpuMs(), frame_stats.CpuPercentileMs(0.95));
+    if (last.gpu_ms >= 0)
+        snprintf(lines[1], sizeof(lines[1]), "gpu  %6.2f ms  mean %6.2f", last.gpu_ms, frame_stats.MeanGpuMs());
+    else
+        snprintf(lines[1], sizeof(lines[1]), "gpu  n/a");
+    snprintf(lines[2], sizeof(lines[2]), "points %lld", static_cast<long long>(last.points));
+    snprintf(lines[3], sizeof(lines[3]), "pick %6.2f ms", last.pick_ms);
+
+    glColor3f(1.0, 1.0, 0.3);
+    for (int i = 0; i < 4; ++i)
+    {
+        glRasterPos2i(10, win_height - 20 - 16 * i);
+        for (const char* c = lines[i]; *c; ++c)
+            glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+
+    // cpu frame time histogram, 2 ms bins, the last one collects the slower frames
+    const double bin_ms = 2.0;
+    const auto hist = frame_stats.CpuHistogram(bin_ms, 25);
+    const int hist_max = std::max(1, *std::max_element(hist.begin(), hist.end()));
+    const int left = 10, bottom = win_height - 190, height = 100, bar = 8;
+    glColor3f(0.3, 0.8, 1.0);
+    glBegin(GL_QUADS);
+    for (size_t i = 0; i < hist.size(); ++i)
+    {
+        const int x = left + static_cast<int>(i) * bar;
+        const int top = bottom + height * hist[i] / hist_max;
+        glVertex2i(x, bottom);
+        glVertex2i(x + bar - 1, bottom);
+        glVertex2i(x + bar - 1, top);
+        glVertex2i(x, top);
+    }
+    glEnd();
+
+    glColor3f(1.0, 1.0, 0.3);
+    glRasterPos2i(left, bottom - 14);
+    char axis[32];
+    snprintf(axis, sizeof(axis), "0 .. %.0f+ ms", bin_ms * (hist.size() - 1));
+    for (const char* c = axis; *c; ++c)
+        glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+
+    glPopAttrib();
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 }
 
 void GlWindow::InitMenu()
@@ -200,6 +338,21 @@ void GlWindow::InitMenu()
             ProjectCurveOntoSurface(rect_box_vertex, curve_vertex);
             spline_vertex = CreateSpline(curve_vertex);
             break;
+        case 104:
+            if (refine_func && !rect_box_vertex.empty())
+            {
+                TRACE_SCOPE("GlWindow refine");
+                refine_func(rect_box_vertex);
+            }
+            break;
+        case 105:
+            show_stats = !show_stats;
+            glutPostRedisplay();
+            break;
+        case 106:
+            if (frame_stats.WriteCsv("frame_stats.csv"))
+                std::cout << "wrote " << frame_stats.Size() << " frames to frame_stats.csv\n";
+            break;
         case 27:
             exit(0);
             break;
@@ -209,6 +362,9 @@ void GlWindow::InitMenu()
     glutAddMenuEntry("spline", 101);
     glutAddMenuEntry("reset", 102);
     glutAddMenuEntry("surface", 103);
+    glutAddMenuEntry("refine", 104);
+    glutAddMenuEntry("stats", 105);
+    glutAddMenuEntry("dump stats", 106);
     glutAddMenuEntry("exit", 27);
     glutAttachMenu(GLUT_RIGHT_BUTTON);
 }
@@ -232,6 +388,10 @@ void GlWindow::SetCallbacks()
 
     glutMotionFunc(FnPtr<void(int, int)>(
         [this](int x, int y) { MotionFunc(x, y); }));
+
+    timer_cb = FnPtr<void(int)>(
+        [this](int value) { TimerFunc(value); });
+    glutTimerFunc(update_interval, timer_cb, 0);
 }
 
 void GlWindow::ReshapeFunc(int width, int height)
@@ -245,6 +405,9 @@ void GlWindow::ReshapeFunc(int width, int height)
 
 void GlWindow::DisplayFunc()
 {
+    TRACE_SCOPE("GlWindow::DisplayFunc");
+    auto start = std::chrono::steady_clock::now();
+
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(g_fov, win_aspect, zNear, zFar);
@@ -258,8 +421,21 @@ void GlWindow::DisplayFunc()
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // the slot's previous frame goes in without gpu numbers if they're still not back
+    const int slot = frame_index % query_slots;
+    CollectFrameSamples(frame_index - query_slots + 1);
+    if (timer_query)
+        glBeginQuery(GL_TIME_ELAPSED, frame_queries[slot][0]);
+
     if (draw_frame_func)
+    {
+        TRACE_SCOPE("GlWindow draw frame");
+        if (primitive_query)
+            glBeginQuery(GL_PRIMITIVES_GENERATED, frame_queries[slot][1]);
         draw_frame_func();
+        if (primitive_query)
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+    }
 
     if (!rect_box_vertex.empty())
         DrawRectBoxVertex();
@@ -270,6 +446,21 @@ void GlWindow::DisplayFunc()
     if (!spline_vertex.empty())
         DrawSpline();
 
+    if (timer_query)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    FrameSample& sample = slot_samples[slot];
+    sample = FrameSample();
+    sample.cpu_ms = ElapsedMs(start);
+    sample.frame = frame_index++;
+    sample.pick_ms = pick_ms;
+    sample.points = primitive_query && draw_frame_func ? 0 : -1;
+    pick_ms = 0.0;
+    CollectFrameSamples(0);
+
+    if (show_stats)
+        DrawStatsOverlay();
+
     glutSwapBuffers();
 }
 
@@ -324,6 +515,10 @@ void GlWindow::KeyboardFunc(unsigned char ch, int x, int y)
     case 'C':
         curve_down = true;
         break;
+    case 's':
+    case 'S':
+        show_stats = !show_stats;
+        break;
     }
 
     glutPostRedisplay();
@@ -382,15 +577,21 @@ void GlWindow::MotionFunc(int x, int y)
     {
         if (rect_box_func)
         {
+            TRACE_SCOPE("GlWindow pick rect");
+            auto pick_start = std::chrono::steady_clock::now();
             rect_box_vertex = rect_box_func(
                 rect_x, win_height - rect_y, x, win_height - y);
+            pick_ms += ElapsedMs(pick_start);
         }
     }
     else if (leftDown && curve_down)
     {
         if (curve_func)
         {
+            TRACE_SCOPE("GlWindow pick curve");
+            auto pick_start = std::chrono::steady_clock::now();
             Eigen::Vector3d ver = curve_func(x, win_height - y);
+            pick_ms += ElapsedMs(pick_start);
             if (!ver.isZero())
             {
                 if (curve_vertex.empty() ||
@@ -421,6 +622,15 @@ void GlWindow::MotionFunc(int x, int y)
     glutPostRedisplay();
 }
 
+void GlWindow::TimerFunc(int value)
+{
+    TRACE_SCOPE("GlWindow::TimerFunc");
+    if (update_func && update_func())
+        glutPostRedisplay();
+
+    glutTimerFunc(update_interval, timer_cb, value);
+}
+
 void GlWindow::SetBoundaryBox(const WinBoundary& bound)
 {
     auto& bmin = bound.wmin;
@@ -1,5 +1,6 @@
 #pragma once
 #include "def/win_boundary.h"
+#include "frame_stats.h"
 #include <GL/glut.h>
 #include <functional>
 #include <string>
@@ -11,6 +12,10 @@ public:
     using DrawFrameFunc = std::function<void()>;
     using RectBoxFunc = std::function<std::vector<Eigen::Vector3d>(int, int, int, int)>;
     using CurveFunc = std::function<Eigen::Vector3d(int, int)>;
+    // called with the selected rect box vertex from the menu
+    using RefineFunc = std::function<void(const std::vector<Eigen::Vector3d>&)>;
+    // polled from the glut loop, return true to redraw
+    using UpdateFunc = std::function<bool()>;
 
 public:
     GlWindow(const std::string& window_name);
@@ -20,6 +25,14 @@ public:
     void SetDrawFrameFunc(const DrawFrameFunc& func) { draw_frame_func = func; }
     void SetRectBoxFunc(const RectBoxFunc& func) { rect_box_func = func; }
     void SetCurveFunc(const CurveFunc& func) { curve_func = func; }
+    void SetRefineFunc(const RefineFunc& func) { refine_func = func; }
+    void SetUpdateFunc(const UpdateFunc& func) { update_func = func; }
+
+    // cpu / gpu frame time, points drawn and picking time of the last frames,
+    // drawn over the scene while the overlay is shown ('s' or the stats menu entry)
+    void SetStatsOverlay(bool show) { show_stats = show; }
+    const FrameStats& GetFrameStats() const { return frame_stats; }
+    bool DumpFrameStats(const std::string& csv_path) const { return frame_stats.WriteCsv(csv_path); }
 
 private:
     void InitGL(const std::string& window_name);
@@ -34,11 +47,18 @@ private:
     void KeyboardUpFunc(unsigned char ch, int x, int y);
     void MouseFunc(int button, int state, int x, int y);
     void MotionFunc(int x, int y);
+    void TimerFunc(int value);
 
     void DrawRectBoxVertex();
     void DrawCurveVertex();
     void DrawSpline();
 
+    // gpu queries are read back once GL_QUERY_RESULT_AVAILABLE says so, nothing waits on the gpu
+    void InitFrameQueries();
+    // adds the finished frames to frame_stats oldest first, frames before force_before go in anyway
+    void CollectFrameSamples(int64_t force_before);
+    void DrawStatsOverlay();
+
 private:
     DrawFrameFunc draw_frame_func;
 
@@ -49,6 +69,12 @@ private:
     std::vector<Eigen::Vector3d> curve_vertex;
     std::vector<Eigen::Vector3d> spline_vertex;
 
+    RefineFunc refine_func;
+
+    UpdateFunc update_func;
+    void (*timer_cb)(int) = nullptr;
+    const unsigned int update_interval = 30; // ms
+
 private:
     const double g_fov;
 
@@ -73,4 +99,15 @@ private:
 
     // curve
     bool curve_down = false;
+
+    // frame stats
+    FrameStats frame_stats;
+    bool show_stats = false;
+    bool timer_query = false, primitive_query = false;
+    static const int query_slots = 3;
+    GLuint frame_queries[query_slots][2] = {}; // [frame % query_slots][time elapsed, primitives generated]
+    FrameSample slot_samples[query_slots];
+    int64_t frame_index = 0;
+    int64_t collect_index = 0; // oldest frame not in frame_stats yet
+    double pick_ms = 0.0; // picking since the last frame
 };
\ No newline at end of file
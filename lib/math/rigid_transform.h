@@ -0,0 +1,14 @@
+#pragma once
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include <Eigen/Geometry>
+
+// moves every vertex by transform, bound is extended by the moved positions
+inline void TransformModel(Model& model, const Eigen::Isometry3d& transform, WinBoundary& bound)
+{
+    for (auto& vertex : model)
+    {
+        vertex.pos = transform * vertex.pos;
+        bound.Extend(vertex.pos);
+    }
+}
@@ -0,0 +1,347 @@
+#include "census_sgm.h"
+#include "concurrent/parallel_for.h"
+#include <opencv2/calib3d.hpp>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CENSUS_SGM_X86 1
+#endif
+
+namespace
+{
+
+constexpr int census_w = 9;
+constexpr int census_h = 7;
+constexpr uint16_t invalid_cost = 64;
+// neighbouring scanlines of a path stepped together, see Compute
+constexpr int scanline_block = 16;
+
+cv::Mat CensusTransform(const cv::Mat& img)
+{
+    const int rows = img.rows, cols = img.cols;
+    const int rw = census_w / 2, rh = census_h / 2;
+
+    cv::Mat census = cv::Mat::zeros(rows, cols, CV_64F); // bit pattern, not a double
+    ParallelFor(rh, std::max(rh, rows - rh), [&](size_t begin, size_t end, int) {
+        for (int v = static_cast<int>(begin); v < static_cast<int>(end); ++v)
+        {
+            uint64_t* dst = census.ptr<uint64_t>(v);
+            for (int u = rw; u < cols - rw; ++u)
+            {
+                const uchar center = img.ptr<uchar>(v)[u];
+                uint64_t bits = 0;
+                for (int dv = -rh; dv <= rh; ++dv)
+                {
+                    const uchar* src = img.ptr<uchar>(v + dv);
+                    for (int du = -rw; du <= rw; ++du)
+                    {
+                        if (dv == 0 && du == 0)
+                            continue;
+                        bits = (bits << 1) | (src[u + du] < center);
+                    }
+                }
+                dst[u] = bits;
+            }
+        }
+    });
+
+    return census;
+}
+
+// cost[u * D + d] = hamming(left(u), right(u - d))
+void CostRowGeneric(const uint64_t* cl, const uint64_t* cr, int cols, int D, uint8_t* cost)
+{
+    for (int u = 0; u < cols; ++u)
+    {
+        uint8_t* c = cost + u * D;
+        for (int d = 0; d < D; ++d)
+            c[d] = d <= u ? __builtin_popcountll(cl[u] ^ cr[u - d]) : invalid_cost;
+    }
+}
+
+// returns min of the new path costs
+uint16_t PathStepGeneric(const uint8_t* cost, const uint16_t* prev, uint16_t prev_min,
+                         uint16_t* cur, uint16_t* sum, int D, uint16_t P1, uint16_t P2)
+{
+    uint16_t cur_min = 0xFFFF;
+    const int jump = prev_min + P2;
+    for (int d = 0; d < D; ++d)
+    {
+        int m = std::min<int>(prev[d], jump);
+        m = std::min<int>(m, prev[d - 1] + P1);
+        m = std::min<int>(m, prev[d + 1] + P1);
+        const uint16_t l = static_cast<uint16_t>(cost[d] + m - prev_min);
+        cur[d] = l;
+        sum[d] = static_cast<uint16_t>(std::min<int>(0xFFFF, sum[d] + l));
+        cur_min = std::min(cur_min, l);
+    }
+    return cur_min;
+}
+
+#ifdef CENSUS_SGM_X86
+
+// popcount of each 64 bit lane, nibble lookup then a byte sum per lane
+__attribute__((target("avx2"))) inline __m256i Popcount64Avx2(__m256i x)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+    const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low4));
+    const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low4));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+// 16 disparities per step: four xor + popcount of 4 reversed right census each,
+// then the 16 counts are gathered into bytes in disparity order
+__attribute__((target("avx2,popcnt"))) void CostRowAvx2(const uint64_t* cl, const uint64_t* cr,
+                                                          int cols, int D, uint8_t* cost)
+{
+    // dword k of the permuted block holds d + k, d + 4 + k, d + 8 + k, d + 12 + k
+    const __m256i gather_lanes = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m128i transpose = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    // left border, some disparities fall outside the right image
+    const int border = std::min(cols, D - 1);
+    for (int u = 0; u < border; ++u)
+    {
+        uint8_t* c = cost + u * D;
+        for (int d = 0; d < D; ++d)
+            c[d] = d <= u ? _mm_popcnt_u64(cl[u] ^ cr[u - d]) : invalid_cost;
+    }
+
+    for (int u = border; u < cols; ++u)
+    {
+        const __m256i left = _mm256_set1_epi64x(static_cast<long long>(cl[u]));
+        uint8_t* c = cost + u * D;
+        for (int d = 0; d < D; d += 16)
+        {
+            __m256i r[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                // cr[u - d - 4j - 3 .. u - d - 4j], reversed so lane k is disparity d + 4j + k
+                const __m256i right = _mm256_loadu_si256((const __m256i*)(cr + u - d - 4 * j - 3));
+                r[j] = Popcount64Avx2(_mm256_xor_si256(left, _mm256_permute4x64_epi64(right, 0x1B)));
+            }
+
+            // byte j of lane k is disparity d + 4j + k
+            const __m256i packed = _mm256_or_si256(_mm256_or_si256(r[0], _mm256_slli_epi64(r[1], 8)),
+                                                   _mm256_or_si256(_mm256_slli_epi64(r[2], 16),
+                                                                   _mm256_slli_epi64(r[3], 24)));
+            const __m128i block = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(packed, gather_lanes));
+            _mm_storeu_si128((__m128i*)(c + d), _mm_shuffle_epi8(block, transpose));
+        }
+    }
+}
+
+__attribute__((target("avx2"))) uint16_t PathStepAvx2(const uint8_t* cost, const uint16_t* prev,
+                                                      uint16_t prev_min, uint16_t* cur, uint16_t* sum,
+                                                      int D, uint16_t P1, uint16_t P2)
+{
+    const __m256i vp1 = _mm256_set1_epi16(P1);
+    const __m256i vjump = _mm256_set1_epi16(prev_min + P2);
+    const __m256i vprev_min = _mm256_set1_epi16(prev_min);
+    __m256i vmin = _mm256_set1_epi16(-1);
+
+    for (int d = 0; d < D; d += 16)
+    {
+        const __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(cost + d)));
+        const __m256i p0 = _mm256_loadu_si256((const __m256i*)(prev + d));
+        const __m256i pm = _mm256_loadu_si256((const __m256i*)(prev + d - 1));
+        const __m256i pp = _mm256_loadu_si256((const __m256i*)(prev + d + 1));
+
+        __m256i m = _mm256_min_epu16(p0, vjump);
+        m = _mm256_min_epu16(m, _mm256_adds_epu16(pm, vp1));
+        m = _mm256_min_epu16(m, _mm256_adds_epu16(pp, vp1));
+        const __m256i l = _mm256_add_epi16(c, _mm256_sub_epi16(m, vprev_min));
+
+        _mm256_storeu_si256((__m256i*)(cur + d), l);
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(sum + d));
+        _mm256_storeu_si256((__m256i*)(sum + d), _mm256_adds_epu16(s, l));
+        vmin = _mm256_min_epu16(vmin, l);
+    }
+
+    const __m128i m128 = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    return static_cast<uint16_t>(_mm_extract_epi16(_mm_minpos_epu16(m128), 0));
+}
+
+#endif
+
+} // namespace
+
+CensusSgm::CensusSgm(const CensusSgmParams& params)
+    : params(params)
+{
+    CV_Assert(params.num_disparities > 0 && params.num_disparities % 16 == 0);
+}
+
+bool CensusSgm::UseAvx2()
+{
+#ifdef CENSUS_SGM_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+cv::Mat CensusSgm::Compute(const cv::Mat& left, const cv::Mat& right) const
+{
+    CV_Assert(left.type() == CV_8UC1 && right.type() == CV_8UC1 && left.size() == right.size());
+
+    const int rows = left.rows, cols = left.cols;
+    const int D = params.num_disparities;
+    const uint16_t P1 = static_cast<uint16_t>(params.p1);
+    const uint16_t P2 = static_cast<uint16_t>(params.p2);
+    const bool avx2 = UseAvx2();
+
+#ifdef CENSUS_SGM_X86
+    auto cost_row = avx2 ? CostRowAvx2 : CostRowGeneric;
+    auto path_step = avx2 ? PathStepAvx2 : PathStepGeneric;
+#else
+    auto cost_row = CostRowGeneric;
+    auto path_step = PathStepGeneric;
+#endif
+
+    // cost volume laid out [v][u][d], a pixel's costs share cache lines
+    const cv::Mat census_l = CensusTransform(left);
+    const cv::Mat census_r = CensusTransform(right);
+    std::vector<uint8_t> cost(static_cast<size_t>(rows) * cols * D);
+    ParallelFor(0, rows, [&](size_t begin, size_t end, int) {
+        for (size_t v = begin; v < end; ++v)
+        {
+            cost_row(census_l.ptr<uint64_t>(v), census_r.ptr<uint64_t>(v), cols, D,
+                     cost.data() + v * cols * D);
+        }
+    });
+
+    // every path splits into independent scanlines, threads share a path
+    // and never touch the same pixel, so the sum volume needs no locking.
+    // scanlines starting side by side are stepped together in blocks, at each step
+    // a vertical or diagonal block reads neighbouring pixels of one row instead of
+    // striding a whole row of the volume per scanline
+    std::vector<uint16_t> sum(cost.size(), 0);
+    const cv::Point dirs[8] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
+    for (const auto& dir : dirs)
+    {
+        std::vector<cv::Point> starts;
+        if (dir.y != 0)
+        {
+            for (int u = 0; u < cols; ++u)
+                starts.emplace_back(u, dir.y > 0 ? 0 : rows - 1);
+        }
+        if (dir.x != 0)
+        {
+            // corner already started by the row above
+            const int skip = dir.y != 0 ? 1 : 0;
+            for (int i = skip; i < rows; ++i)
+                starts.emplace_back(dir.x > 0 ? 0 : cols - 1, dir.y >= 0 ? i : rows - 1 - i);
+        }
+
+        // rows are contiguous already, a horizontal block would stride between rows
+        const size_t block = dir.y != 0 ? scanline_block : 1;
+        ParallelFor(0, starts.size(), [&](size_t begin, size_t end, int) {
+            // per scanline D values with a sentinel on both sides for the d - 1 / d + 1 taps
+            const size_t stride = D + 2;
+            std::vector<uint16_t> buf0(block * stride), buf1(block * stride);
+            std::vector<uint16_t> prev_min(block);
+            for (size_t first = begin; first < end; first += block)
+            {
+                const size_t count = std::min(block, end - first);
+                std::fill(buf0.begin(), buf0.end(), 0xFFFF);
+                std::fill(buf1.begin(), buf1.end(), 0xFFFF);
+                for (size_t j = 0; j < count; ++j)
+                    std::fill_n(buf0.data() + j * stride + 1, D, 0);
+                std::fill(prev_min.begin(), prev_min.end(), 0);
+
+                uint16_t* prev = buf0.data() + 1;
+                uint16_t* cur = buf1.data() + 1;
+                for (int step = 0;; ++step)
+                {
+                    bool inside = false;
+                    for (size_t j = 0; j < count; ++j)
+                    {
+                        const cv::Point p = starts[first + j] + step * dir;
+                        if (p.x < 0 || p.x >= cols || p.y < 0 || p.y >= rows)
+                            continue;
+
+                        const size_t offset = (static_cast<size_t>(p.y) * cols + p.x) * D;
+                        prev_min[j] = path_step(cost.data() + offset, prev + j * stride, prev_min[j],
+                                                cur + j * stride, sum.data() + offset, D, P1, P2);
+                        inside = true;
+                    }
+                    if (!inside)
+                        break;
+                    std::swap(prev, cur);
+                }
+            }
+        });
+    }
+
+    // winner takes all, uniqueness, subpixel and left right check
+    cv::Mat disp(rows, cols, CV_16S, cv::Scalar(-16));
+    ParallelFor(0, rows, [&](size_t begin, size_t end, int) {
+        std::vector<int> disp_r(cols);
+        std::vector<uint32_t> min_r(cols);
+        for (size_t v = begin; v < end; ++v)
+        {
+            std::fill(disp_r.begin(), disp_r.end(), -1);
+            std::fill(min_r.begin(), min_r.end(), UINT32_MAX);
+
+            short* dst = disp.ptr<short>(static_cast<int>(v));
+            for (int u = 0; u < cols; ++u)
+            {
+                const uint16_t* s = sum.data() + (v * cols + u) * D;
+                const int max_d = std::min(D - 1, u);
+
+                int best = 0;
+                for (int d = 1; d <= max_d; ++d)
+                {
+                    if (s[d] < s[best])
+                        best = d;
+                }
+                for (int d = 0; d <= max_d; ++d)
+                {
+                    if (s[d] < min_r[u - d])
+                    {
+                        min_r[u - d] = s[d];
+                        disp_r[u - d] = d;
+                    }
+                }
+
+                bool unique = true;
+                for (int d = 0; d <= max_d && unique; ++d)
+                {
+                    if (std::abs(d - best) > 1 &&
+                        s[d] * (100 - params.uniqueness_ratio) < s[best] * 100)
+                        unique = false;
+                }
+                if (!unique)
+                    continue;
+
+                int sub = best * 16;
+                if (best > 0 && best < max_d)
+                {
+                    const int denom = s[best - 1] + s[best + 1] - 2 * s[best];
+                    if (denom > 0)
+                        sub += (s[best - 1] - s[best + 1]) * 8 / denom;
+                }
+                dst[u] = static_cast<short>(sub);
+            }
+
+            for (int u = 0; u < cols; ++u)
+            {
+                if (dst[u] < 0)
+                    continue;
+                const int d = (dst[u] + 8) / 16;
+                if (u - d < 0 || disp_r[u - d] < 0 ||
+                    std::abs(disp_r[u - d] - d) > params.disp12_max_diff)
+                    dst[u] = -16;
+            }
+        }
+    });
+
+    cv::filterSpeckles(disp, -16, params.speckle_window_size, params.speckle_range * 16);
+    return disp;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+struct CensusSgmParams
+{
+    int num_disparities = 64; // multiple of 16
+    int p1 = 10;
+    int p2 = 120;
+    int uniqueness_ratio = 10;
+    int disp12_max_diff = 1;
+    int speckle_window_size = 100;
+    int speckle_range = 2;
+};
+
+// census 9x7 matching cost with 8 path semi-global aggregation,
+// avx2 kernels picked at runtime when the cpu supports them
+class CensusSgm
+{
+public:
+    CensusSgm(const CensusSgmParams& params = CensusSgmParams());
+
+    // gray rectified pair -> CV_16S disparity * 16, invalid is -16 like StereoSGBM
+    cv::Mat Compute(const cv::Mat& left, const cv::Mat& right) const;
+
+    static bool UseAvx2();
+
+private:
+    const CensusSgmParams params;
+};
@@ -1,4 +1,9 @@
 #include "sgbm_solver.h"
+#include "census_sgm.h"
+#include "concurrent/parallel_for.h"
+#include "model_generator/rgbd/rgbd_file.h"
+#include "profiling/trace.h"
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 
 #define USE_STEREO 1
@@ -8,6 +13,10 @@ using namespace CameraPara;
 namespace
 {
 
+// valid range of the reprojected depth
+constexpr double min_depth = 25.0;
+constexpr double max_depth = 60.0;
+
 void FillDepthMap32F(cv::Mat& depth)
 {
     const int width = depth.cols;
@@ -97,6 +106,86 @@ void FillDepthMap32F(cv::Mat& depth)
     }
 }
 
+// CV_16S
+cv::Mat ComputeSgbm(const cv::Mat& imgL, const cv::Mat& imgR, const SgbmParams& params)
+{
+    if (params.backend == SgbmParams::CENSUS_SGM)
+    {
+        CensusSgmParams census_params;
+        census_params.num_disparities = (params.num_disparities + 15) / 16 * 16;
+        return CensusSgm(census_params).Compute(imgL, imgR);
+    }
+
+    //SGBM
+    int mindisparity = params.min_disparity;
+    int ndisparities = params.num_disparities;
+    int SADWindowSize = params.block_size; //blocksize
+    cv::Ptr<cv::StereoSGBM> sgbm = cv::StereoSGBM::create(mindisparity, ndisparities, SADWindowSize);
+
+    int P1 = 8 * imgL.channels() * SADWindowSize * SADWindowSize;
+    int P2 = 32 * imgL.channels() * SADWindowSize * SADWindowSize;
+    sgbm->setP1(P1);
+    sgbm->setP2(P2);
+    sgbm->setPreFilterCap(15);
+    sgbm->setUniquenessRatio(10);
+    sgbm->setSpeckleRange(2);
+    sgbm->setSpeckleWindowSize(100);
+    sgbm->setDisp12MaxDiff(1);
+    sgbm->setMode(params.mode);
+
+    cv::Mat disp;
+    sgbm->compute(imgL, imgR, disp);
+    return disp;
+}
+
+// each strip is solved with margin rows above and below, only its own rows are kept
+cv::Mat ComputeSgbmStrips(const cv::Mat& imgL, const cv::Mat& imgR, const SgbmParams& params,
+                          int strips, int margin)
+{
+    const int rows = imgL.rows;
+    const int strip_rows = (rows + strips - 1) / strips;
+
+    cv::Mat disp(imgL.size(), CV_16S);
+    auto solve_strips = [&](size_t begin, size_t end, int) {
+        for (size_t s = begin; s < end; ++s)
+        {
+            const int y0 = static_cast<int>(s) * strip_rows;
+            const int y1 = std::min(rows, y0 + strip_rows);
+            if (y0 >= y1)
+                continue;
+
+            const int top = std::max(0, y0 - margin);
+            const int bot = std::min(rows, y1 + margin);
+            const cv::Range range(top, bot);
+            TRACE_SCOPE("ComputeSgbm strip");
+            cv::Mat strip = ComputeSgbm(imgL.rowRange(range), imgR.rowRange(range), params);
+            strip.rowRange(y0 - top, y1 - top).copyTo(disp.rowRange(y0, y1));
+        }
+    };
+    ParallelFor(0, strips, solve_strips, strips);
+
+    return disp;
+}
+
+// point of pixel (u, v), false if its depth is out of range
+bool PixelVertex(const StereoFrame& frame, int u, int v, ModelVertex& vertex)
+{
+    const cv::Mat& color_map = frame.left_color;
+    double d = frame.depth.ptr<float>(v)[u];
+    if (frame.metric_depth ? d <= 0 : (d > max_depth || d < min_depth))
+        return false;
+
+    Eigen::Vector3d& pos = vertex.pos;
+    pos.z() = d;
+    pos.x() = (u + frame.offset.x - cx) * pos.z() / fx;
+    pos.y() = (v + frame.offset.y - cy) * pos.z() / fy;
+    ModelColor& color = vertex.color;
+    color.b = color_map.data[v * color_map.step + u * color_map.channels()];
+    color.g = color_map.data[v * color_map.step + u * color_map.channels() + 1];
+    color.r = color_map.data[v * color_map.step + u * color_map.channels() + 2];
+    return true;
+}
+
 } // namespace
 
 SgbmSolver::SgbmSolver(const std::string& resource_path,
@@ -112,88 +201,302 @@ SgbmSolver::SgbmSolver(const std::string& resource_path,
 
 Model SgbmSolver::Solve(const std::string& left_image_name,
                         const std::string& right_image_name,
-                        WinBoundary& bound) const
+                        WinBoundary& bound,
+                        StereoFrame* solved_frame) const
 {
+    TRACE_SCOPE("SgbmSolver::Solve");
+    StereoFrame frame;
+    if (!Load(left_image_name, right_image_name, frame))
+        return {};
+
+    Rectify(frame);
+    ComputeDisparity(frame);
+
+    // disparity map
+    cv::Mat disp8U;
+    cv::normalize(frame.disp, disp8U, 0, 255, cv::NORM_MINMAX, CV_8UC1);
+    cv::imwrite("disparity.jpg", disp8U);
+
+    ComputeDepth(frame);
+    cv::imwrite("depth_before.jpg", frame.depth);
+    FillDepth(frame);
+    cv::imwrite("depth_after.jpg", frame.depth);
+
+    if (solved_frame)
+        *solved_frame = frame;
+
+    return Reproject(frame, bound);
+}
+
+Model SgbmSolver::SolveRegion(const std::string& left_image_name,
+                              const std::string& right_image_name,
+                              const cv::Rect& roi,
+                              const SgbmParams& region_params,
+                              const StereoFrame& full_frame,
+                              WinBoundary& bound) const
+{
+    TRACE_SCOPE("SgbmSolver::SolveRegion");
+    const cv::Rect image_rect(cv::Point(0, 0), rectifier.image_size());
+    const cv::Rect region = roi & image_rect;
+    if (region.empty())
+        return {};
+
+    StereoFrame frame;
+    if (!Load(left_image_name, right_image_name, frame))
+        return {};
+
+    // matching needs the disparity range on the left and a few rows around
+    const int margin = 2 * region_params.block_size;
+    const cv::Rect ext = cv::Rect(region.x - region_params.num_disparities, region.y - margin,
+                                  region.width + region_params.num_disparities,
+                                  region.height + 2 * margin) &
+                         image_rect;
+    const cv::Rect inner(region.tl() - ext.tl(), region.size());
+
+    cv::Mat left_color = rectifier.rectify(frame.left_color, Rectifier::LEFT, ext);
+    cv::Mat right = rectifier.rectify(frame.right, Rectifier::RIGHT, ext);
+    cv::Mat left;
+    cv::cvtColor(left_color, left, cv::COLOR_BGR2GRAY);
+
+    cv::Mat disp = ComputeSgbm(left, right, region_params);
+    disp(inner).convertTo(frame.disp, CV_32F, 1.0 / 16);
+    frame.disp_min = full_frame.disp_min;
+    frame.disp_max = full_frame.disp_max;
+    frame.left_color = left_color(inner).clone();
+    frame.offset = region.tl();
+
+    ComputeDepth(frame);
+    FillDepth(frame);
+
+    return Reproject(frame, bound);
+}
+
+SgbmParams SgbmSolver::RegionParams() const
+{
+    SgbmParams region_params = params;
+    region_params.num_disparities = 2 * params.num_disparities;
+    region_params.block_size = 3;
+    region_params.mode = cv::StereoSGBM::MODE_HH;
+
+    return region_params;
+}
+
+cv::Rect SgbmSolver::RegionOf(const std::vector<Eigen::Vector3d>& vertex) const
+{
+    double umin = 1e10, vmin = 1e10, umax = -1e10, vmax = -1e10;
+    for (const auto& pos : vertex)
+    {
+        if (pos.z() <= 0)
+            continue;
+
+        const double u = pos.x() * fx / pos.z() + cx;
+        const double v = pos.y() * fy / pos.z() + cy;
+        umin = std::min(umin, u);
+        vmin = std::min(vmin, v);
+        umax = std::max(umax, u);
+        vmax = std::max(vmax, v);
+    }
+    if (umin > umax)
+        return {};
+
+    const cv::Rect image_rect(cv::Point(0, 0), rectifier.image_size());
+    return cv::Rect(cv::Point(cvFloor(umin), cvFloor(vmin)),
+                    cv::Point(cvCeil(umax) + 1, cvCeil(vmax) + 1)) &
+           image_rect;
+}
+
+void SgbmSolver::Splice(Model& model, const Model& region_model, const cv::Rect& roi) const
+{
+    auto inside = [this, &roi](const ModelVertex& vertex) {
+        const auto& pos = vertex.pos;
+        if (pos.z() <= 0)
+            return false;
+
+        const int u = cvRound(pos.x() * fx / pos.z() + cx);
+        const int v = cvRound(pos.y() * fy / pos.z() + cy);
+        return roi.contains(cv::Point(u, v));
+    };
+
+    model.erase(std::remove_if(model.begin(), model.end(), inside), model.end());
+    model.insert(model.end(), region_model.begin(), region_model.end());
+}
+
+bool SgbmSolver::Load(const std::string& left_image_name,
+                      const std::string& right_image_name,
+                      StereoFrame& frame) const
+{
+    TRACE_SCOPE("SgbmSolver::Load");
     const std::string left_img = left_image_path + "/" + left_image_name;
     const std::string right_img = right_image_path + "/" + right_image_name;
-    cv::Mat imgL = cv::imread(left_img, cv::IMREAD_GRAYSCALE);
-    cv::Mat imgR = cv::imread(right_img, cv::IMREAD_GRAYSCALE);
+    frame.left_color = cv::imread(left_img);
+    frame.right = cv::imread(right_img, cv::IMREAD_GRAYSCALE);
 
-    imgL = rectifier.rectify(imgL, Rectifier::LEFT);
-    imgR = rectifier.rectify(imgR, Rectifier::RIGHT);
+    return !frame.left_color.empty() && !frame.right.empty();
+}
 
-    //SGBM
-    int mindisparity = 0;
-    int ndisparities = 64;
-    int SADWindowSize = 5; //blocksize
-    cv::Ptr<cv::StereoSGBM> sgbm = cv::StereoSGBM::create(mindisparity, ndisparities, SADWindowSize);
+void SgbmSolver::Rectify(StereoFrame& frame) const
+{
+    TRACE_SCOPE("SgbmSolver::Rectify");
+    frame.left_color = rectifier.rectify(frame.left_color, Rectifier::LEFT);
+    frame.right = rectifier.rectify(frame.right, Rectifier::RIGHT);
+    cv::cvtColor(frame.left_color, frame.left, cv::COLOR_BGR2GRAY);
+}
 
-    int P1 = 8 * imgL.channels() * SADWindowSize * SADWindowSize;
-    int P2 = 32 * imgL.channels() * SADWindowSize * SADWindowSize;
-    sgbm->setP1(P1);
-    sgbm->setP2(P2);
-    sgbm->setPreFilterCap(15);
-    sgbm->setUniquenessRatio(10);
-    sgbm->setSpeckleRange(2);
-    sgbm->setSpeckleWindowSize(100);
-    sgbm->setDisp12MaxDiff(1);
+void SgbmSolver::ComputeDisparity(StereoFrame& frame) const
+{
+    TRACE_SCOPE("SgbmSolver::ComputeDisparity");
+    cv::Mat disp = strip_count > 1
+                       ? ComputeSgbmStrips(frame.left, frame.right, params, strip_count, StripMargin())
+                       : ComputeSgbm(frame.left, frame.right, params); // CV_16S
+    disp.convertTo(frame.disp, CV_32F, 1.0 / 16); //除以16得到真实视差值
+    cv::minMaxLoc(frame.disp, &frame.disp_min, &frame.disp_max);
+}
 
-    cv::Mat disp;
-    sgbm->compute(imgL, imgR, disp);        // CV_16S
-    disp.convertTo(disp, CV_32F, 1.0 / 16); //除以16得到真实视差值
+int SgbmSolver::StripMargin() const
+{
+    // SGBM paths enter from above, a disparity range of rows lets them settle
+    return std::max(params.num_disparities, 4 * params.block_size);
+}
 
-    // disparity map
-    cv::Mat disp8U = cv::Mat(disp.rows, disp.cols, CV_8UC1);
-    cv::normalize(disp, disp8U, 0, 255, cv::NORM_MINMAX, CV_8UC1);
-    cv::imwrite("disparity.jpg", disp8U);
+void SgbmSolver::ComputeDepth(StereoFrame& frame) const
+{
+    TRACE_SCOPE("SgbmSolver::ComputeDepth");
+    // depth follows the disparity normalized to [0, 255] over the frame range
+    const cv::Mat& disp = frame.disp;
+    const double range = frame.disp_max - frame.disp_min;
+    const double scale = range > 0 ? 255.0 / range : 0.0;
 
-    // depth_map
-    cv::Mat depth = cv::Mat(disp8U.rows, disp8U.cols, CV_32FC1);
-    for (int v = 0; v < disp8U.rows; v++)
+    frame.depth = cv::Mat::zeros(disp.rows, disp.cols, CV_32FC1);
+    for (int v = 0; v < disp.rows; v++)
     {
-        for (int u = 0; u < disp8U.cols; u++)
+        for (int u = 0; u < disp.cols; u++)
         {
-            uchar disp_val = disp8U.ptr<uchar>(v)[u];
-            if (disp_val == 0)
+            double disp_val = std::round((disp.ptr<float>(v)[u] - frame.disp_min) * scale);
+            if (disp_val <= 0)
                 continue;
 
             float d = fx * baseline / disp_val;
-            depth.ptr<float>(v)[u] = d;
+            frame.depth.ptr<float>(v)[u] = d;
+        }
+    }
+}
+
+void SgbmSolver::ComputeMetricDepth(StereoFrame& frame) const
+{
+    ComputeMetricDepth(frame, MetricMinDepth(), MetricMaxDepth());
+}
+
+void SgbmSolver::ComputeMetricDepth(StereoFrame& frame, double min_depth, double max_depth) const
+{
+    TRACE_SCOPE("SgbmSolver::ComputeMetricDepth");
+    frame.depth = MetricDepth(frame.disp, min_depth, max_depth);
+    frame.metric_depth = true;
+    frame.metric_min = min_depth;
+    frame.metric_max = max_depth;
+}
+
+double SgbmSolver::MetricMinDepth() const
+{
+    return fx * baseline / std::max(1, params.min_disparity + params.num_disparities);
+}
+
+double SgbmSolver::MetricMaxDepth() const
+{
+    return fx * baseline / min_metric_disparity;
+}
+
+cv::Mat SgbmSolver::MetricDepth(const cv::Mat& disp, double min_depth, double max_depth) const
+{
+    const double focal_baseline = fx * baseline;
+
+    cv::Mat depth = cv::Mat::zeros(disp.size(), CV_32FC1);
+    for (int v = 0; v < disp.rows; ++v)
+    {
+        const float* disp_row = disp.ptr<float>(v);
+        float* depth_row = depth.ptr<float>(v);
+        for (int u = 0; u < disp.cols; ++u)
+        {
+            if (disp_row[u] <= 0)
+                continue;
+
+            const double d = focal_baseline / disp_row[u];
+            if (d >= min_depth && d <= max_depth)
+                depth_row[u] = static_cast<float>(d);
         }
     }
-    cv::imwrite("depth_before.jpg", depth);
-    FillDepthMap32F(depth);
-    cv::imwrite("depth_after.jpg", depth);
 
+    return depth;
+}
+
+void SgbmSolver::FillDepth(StereoFrame& frame) const
+{
+    TRACE_SCOPE("SgbmSolver::FillDepth");
+    FillDepthMap32F(frame.depth);
+}
+
+Model SgbmSolver::Reproject(const StereoFrame& frame, WinBoundary& bound) const
+{
+    TRACE_SCOPE("SgbmSolver::Reproject");
     // ply_model
     Model model;
-    cv::Mat color_map = rectifier.rectify(cv::imread(left_img), Rectifier::LEFT);
-    for (int v = 0; v < color_map.rows; v++)
+    ModelVertex vertex;
+    for (int v = 0; v < frame.depth.rows; v++)
     {
-        for (int u = 0; u < color_map.cols; u++)
+        for (int u = 0; u < frame.depth.cols; u++)
         {
-            double d = depth.ptr<float>(v)[u];
-            if (d > 60 || d < 25)
+            if (!PixelVertex(frame, u, v, vertex))
                 continue;
 
-            Eigen::Vector3d pos;
-            pos.z() = d;
-            pos.x() = (u - cx) * pos.z() / fx;
-            pos.y() = (v - cy) * pos.z() / fy;
-            ModelColor color;
-            color.b = color_map.data[v * color_map.step + u * color_map.channels()];
-            color.g = color_map.data[v * color_map.step + u * color_map.channels() + 1];
-            color.r = color_map.data[v * color_map.step + u * color_map.channels() + 2];
-            model.push_back({pos, color});
-
-            bound.wmin(0) = std::min(bound.wmin(0), pos.x());
-            bound.wmin(1) = std::min(bound.wmin(1), pos.y());
-            bound.wmin(2) = std::min(bound.wmin(2), pos.z());
-            bound.wmax(0) = std::max(bound.wmax(0), pos.x());
-            bound.wmax(1) = std::max(bound.wmax(1), pos.y());
-            bound.wmax(2) = std::max(bound.wmax(2), pos.z());
+            model.push_back(vertex);
+            bound.Extend(vertex.pos);
         }
     }
 
     return model;
 }
+
+OrganizedModel SgbmSolver::ReprojectOrganized(const StereoFrame& frame, WinBoundary& bound) const
+{
+    TRACE_SCOPE("SgbmSolver::ReprojectOrganized");
+    OrganizedModel model;
+    model.Resize(frame.depth.cols, frame.depth.rows);
+    for (int v = 0; v < model.height; v++)
+    {
+        for (int u = 0; u < model.width; u++)
+        {
+            if (!PixelVertex(frame, u, v, model.At(u, v)))
+                continue;
+
+            model.valid[model.Index(u, v)] = 1;
+            bound.Extend(model.At(u, v).pos);
+        }
+    }
+
+    return model;
+}
+
+PinholeCamera SgbmSolver::Camera() const
+{
+    return {fx, fy, cx, cy};
+}
+
+double SgbmSolver::Baseline() const
+{
+    return baseline;
+}
+
+bool SgbmSolver::Save(const StereoFrame& frame, const std::string& rgbd_path) const
+{
+    RgbdImage image;
+    image.depth = frame.depth;
+    image.color = frame.left_color;
+    image.camera = Camera();
+    image.baseline = baseline;
+    image.offset = frame.offset;
+
+    if (!frame.metric_depth)
+        return WriteRgbd(rgbd_path, image, min_depth, max_depth);
+
+    // the working range sets the 16 bit step, not the farthest outlier
+    return WriteRgbd(rgbd_path, image, frame.metric_min, frame.metric_max);
+}
@@ -1,8 +1,45 @@
+#pragma once
 #include "def/model.h"
+#include "def/organized_model.h"
+#include "def/pinhole.h"
 #include "def/win_boundary.h"
 #include "rectify/rectifier.h"
 #include <string>
 
+// one stereo pair, filled stage by stage
+struct StereoFrame
+{
+    cv::Mat left_color; // BGR
+    cv::Mat left;       // gray
+    cv::Mat right;      // gray
+
+    cv::Mat disp; // CV_32F, real disparity
+    double disp_min = 0.0, disp_max = 0.0;
+
+    cv::Mat depth; // CV_32F
+    // depth from ComputeMetricDepth, 0 marks an invalid pixel
+    bool metric_depth = false;
+    double metric_min = 0.0, metric_max = 0.0; // depth range ComputeMetricDepth kept
+
+    // top left of the frame in the rectified image
+    cv::Point offset = cv::Point(0, 0);
+};
+
+struct SgbmParams
+{
+    enum Backend
+    {
+        OPENCV_SGBM,
+        CENSUS_SGM, // min_disparity 0, num_disparities rounded up to 16
+    };
+
+    Backend backend = OPENCV_SGBM;
+    int min_disparity = 0;
+    int num_disparities = 64;
+    int block_size = 5;
+    int mode = cv::StereoSGBM::MODE_SGBM;
+};
+
 class SgbmSolver
 {
 public:
@@ -14,7 +51,62 @@ public:
     // from left image
     Model Solve(const std::string& left_image_name,
                 const std::string& right_image_name,
-                WinBoundary& bound) const;
+                WinBoundary& bound,
+                StereoFrame* solved_frame = nullptr) const;
+
+    // re-solve roi of the rectified left image with params, depth is scaled
+    // with the disparity range of full_frame so the result splices into its model
+    Model SolveRegion(const std::string& left_image_name,
+                      const std::string& right_image_name,
+                      const cv::Rect& roi,
+                      const SgbmParams& region_params,
+                      const StereoFrame& full_frame,
+                      WinBoundary& bound) const;
+    // wider disparity range and finer matching than GetParams
+    SgbmParams RegionParams() const;
+    // bounding box of the vertices projected into the rectified left image
+    cv::Rect RegionOf(const std::vector<Eigen::Vector3d>& vertex) const;
+    // replace the points of model inside roi by region_model
+    void Splice(Model& model, const Model& region_model, const cv::Rect& roi) const;
+
+    // stages of Solve, each one only reads what the previous one wrote
+    bool Load(const std::string& left_image_name,
+              const std::string& right_image_name,
+              StereoFrame& frame) const;
+    void Rectify(StereoFrame& frame) const;
+    void ComputeDisparity(StereoFrame& frame) const;
+    void ComputeDepth(StereoFrame& frame) const;
+    // fx * baseline / disparity in baseline units, unlike ComputeDepth it doesn't
+    // follow the disparity range of the frame, so depths of frames are comparable.
+    // depth outside the metric working range is dropped
+    void ComputeMetricDepth(StereoFrame& frame) const;
+    void ComputeMetricDepth(StereoFrame& frame, double min_depth, double max_depth) const;
+    cv::Mat MetricDepth(const cv::Mat& disp, double min_depth, double max_depth) const;
+    // metric working range, from the largest disparity searched to min_metric_disparity
+    double MetricMinDepth() const;
+    double MetricMaxDepth() const;
+    void FillDepth(StereoFrame& frame) const;
+    Model Reproject(const StereoFrame& frame, WinBoundary& bound) const;
+    // same points as Reproject, kept on the pixel grid of the frame
+    OrganizedModel ReprojectOrganized(const StereoFrame& frame, WinBoundary& bound) const;
+
+    // depth + color image with calibration, loaded by RgbdLoader
+    bool Save(const StereoFrame& frame, const std::string& rgbd_path) const;
+
+    // rectified left camera and rig baseline
+    PinholeCamera Camera() const;
+    double Baseline() const;
+
+    void SetParams(const SgbmParams& params) { this->params = params; }
+    const SgbmParams& GetParams() const { return params; }
+
+    // smaller disparities are mostly sub-pixel noise and land far away
+    void SetMinMetricDisparity(double disparity) { min_metric_disparity = std::max(disparity, 0.1); }
+
+    // solve horizontal strips concurrently, 1 keeps a single compute call
+    void SetStripCount(int count) { strip_count = std::max(1, count); }
+    // rows each strip is extended by so paths from above settle before the seam
+    int StripMargin() const;
 
 private:
     const std::string resource_path;
@@ -22,4 +114,8 @@ private:
     const std::string right_image_path;
 
     Rectifier rectifier;
-};
\ No newline at end of file
+
+    SgbmParams params;
+    int strip_count = 1;
+    double min_metric_disparity = 2.0;
+};
@@ -1,4 +1,5 @@
 #include "ply_loader.h"
+#include "profiling/trace.h"
 #include <fstream>
 #include <sstream>
 
@@ -9,6 +10,7 @@ PlyLoader::PlyLoader(const std::string& ply_path)
 
 Model PlyLoader::Load(WinBoundary& bound) const
 {
+    TRACE_SCOPE("PlyLoader::Load");
     std::ifstream file(ply_path, std::ios::in);
     std::string line;
 
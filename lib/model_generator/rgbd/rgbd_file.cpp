@@ -0,0 +1,156 @@
+#include "rgbd_file.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <opencv2/imgcodecs.hpp>
+
+namespace
+{
+
+const char rgbd_magic[4] = {'R', 'G', 'B', 'D'};
+constexpr uint32_t rgbd_version = 1;
+
+#pragma pack(push, 1)
+struct RgbdHeader
+{
+    char magic[4];
+    uint32_t version;
+    int32_t width, height;
+    int32_t offset_x, offset_y;
+    double fx, fy, cx, cy;
+    double baseline;
+    double depth_scale; // stored value * depth_scale = depth
+    uint64_t depth_bytes;
+    uint64_t color_bytes;
+};
+#pragma pack(pop)
+
+} // namespace
+
+bool WriteRgbd(const std::string& rgbd_path, const RgbdImage& image,
+               double min_depth, double max_depth, int jpeg_quality)
+{
+    if (image.depth.type() != CV_32FC1 || image.color.size() != image.depth.size() || max_depth <= 0)
+        return false;
+
+    const double depth_scale = max_depth / 65535.0;
+    cv::Mat depth16(image.depth.size(), CV_16UC1);
+    for (int v = 0; v < image.depth.rows; ++v)
+    {
+        const float* src = image.depth.ptr<float>(v);
+        uint16_t* dst = depth16.ptr<uint16_t>(v);
+        for (int u = 0; u < image.depth.cols; ++u)
+        {
+            const double d = src[u];
+            dst[u] = (d < min_depth || d > max_depth) ? 0 : std::max(1, cvRound(d / depth_scale));
+        }
+    }
+
+    std::vector<uchar> depth_buf, color_buf;
+    if (!cv::imencode(".png", depth16, depth_buf, {cv::IMWRITE_PNG_COMPRESSION, 3}) ||
+        !cv::imencode(".jpg", image.color, color_buf, {cv::IMWRITE_JPEG_QUALITY, jpeg_quality}))
+        return false;
+
+    RgbdHeader header;
+    std::memcpy(header.magic, rgbd_magic, sizeof(rgbd_magic));
+    header.version = rgbd_version;
+    header.width = image.depth.cols;
+    header.height = image.depth.rows;
+    header.offset_x = image.offset.x;
+    header.offset_y = image.offset.y;
+    header.fx = image.camera.fx;
+    header.fy = image.camera.fy;
+    header.cx = image.camera.cx;
+    header.cy = image.camera.cy;
+    header.baseline = image.baseline;
+    header.depth_scale = depth_scale;
+    header.depth_bytes = depth_buf.size();
+    header.color_bytes = color_buf.size();
+
+    std::ofstream file(rgbd_path, std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(depth_buf.data()), depth_buf.size());
+    file.write(reinterpret_cast<const char*>(color_buf.data()), color_buf.size());
+
+    return file.good();
+}
+
+RgbdLoader::RgbdLoader(const std::string& rgbd_path)
+    : rgbd_path{rgbd_path}
+{
+}
+
+bool RgbdLoader::Read(RgbdImage& image) const
+{
+    std::ifstream file(rgbd_path, std::ios::in | std::ios::binary);
+    RgbdHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, rgbd_magic, sizeof(rgbd_magic)) != 0 ||
+        header.version != rgbd_version)
+    {
+        return false;
+    }
+
+    // sizes of a corrupt or truncated file must not reach the allocation
+    const std::streampos body = file.tellg();
+    file.seekg(0, std::ios::end);
+    const uint64_t remaining = static_cast<uint64_t>(file.tellg() - body);
+    file.seekg(body);
+    if (!file || header.depth_bytes > remaining || header.color_bytes > remaining - header.depth_bytes)
+        return false;
+
+    std::vector<uchar> depth_buf(header.depth_bytes), color_buf(header.color_bytes);
+    if (!file.read(reinterpret_cast<char*>(depth_buf.data()), depth_buf.size()) ||
+        !file.read(reinterpret_cast<char*>(color_buf.data()), color_buf.size()))
+    {
+        return false;
+    }
+
+    cv::Mat depth16 = cv::imdecode(depth_buf, cv::IMREAD_UNCHANGED);
+    image.color = cv::imdecode(color_buf, cv::IMREAD_COLOR);
+    if (depth16.type() != CV_16UC1 || depth16.cols != header.width || depth16.rows != header.height ||
+        image.color.size() != depth16.size())
+    {
+        return false;
+    }
+
+    depth16.convertTo(image.depth, CV_32F, header.depth_scale);
+    image.camera = {header.fx, header.fy, header.cx, header.cy};
+    image.baseline = header.baseline;
+    image.offset = cv::Point(header.offset_x, header.offset_y);
+
+    return true;
+}
+
+OrganizedModel RgbdLoader::LoadOrganized(WinBoundary& bound) const
+{
+    OrganizedModel model;
+    RgbdImage image;
+    if (!Read(image))
+        return model;
+
+    model.Resize(image.depth.cols, image.depth.rows);
+    for (int v = 0; v < model.height; ++v)
+    {
+        const float* depth = image.depth.ptr<float>(v);
+        const uchar* bgr = image.color.ptr<uchar>(v);
+        for (int u = 0; u < model.width; ++u)
+        {
+            if (depth[u] <= 0)
+                continue;
+
+            auto& vertex = model.At(u, v);
+            vertex.pos = image.camera.BackProject(u + image.offset.x, v + image.offset.y, depth[u]);
+            vertex.color = {bgr[3 * u + 2], bgr[3 * u + 1], bgr[3 * u]};
+            model.valid[model.Index(u, v)] = 1;
+            bound.Extend(vertex.pos);
+        }
+    }
+
+    return model;
+}
+
+Model RgbdLoader::Load(WinBoundary& bound) const
+{
+    return LoadOrganized(bound).ToModel();
+}
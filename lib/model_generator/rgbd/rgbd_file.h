@@ -0,0 +1,35 @@
+#pragma once
+#include "def/model.h"
+#include "def/organized_model.h"
+#include "def/pinhole.h"
+#include "def/win_boundary.h"
+#include <opencv2/core.hpp>
+#include <string>
+
+// .rgbd: header with calibration, 16 bit png depth and jpeg color.
+// depth is quantized to max_depth / 65535, 0 marks an invalid pixel
+struct RgbdImage
+{
+    cv::Mat depth; // CV_32F
+    cv::Mat color; // BGR
+    PinholeCamera camera;
+    double baseline = 0.0;
+    cv::Point offset = cv::Point(0, 0); // top left in the rectified image
+};
+
+// pixels with depth outside [min_depth, max_depth] are stored invalid
+bool WriteRgbd(const std::string& rgbd_path, const RgbdImage& image,
+               double min_depth, double max_depth, int jpeg_quality = 90);
+
+class RgbdLoader
+{
+public:
+    RgbdLoader(const std::string& rgbd_path);
+
+    bool Read(RgbdImage& image) const;
+    Model Load(WinBoundary& bound) const;
+    OrganizedModel LoadOrganized(WinBoundary& bound) const;
+
+private:
+    const std::string rgbd_path;
+};
@@ -0,0 +1,255 @@
+#include "stereo_stream.h"
+#include "profiling/memory_tracker.h"
+#include "profiling/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+
+const char* stage_name[] = {"decode", "rectify", "disparity", "depth", "reproject"};
+
+std::string FileName(const std::string& path)
+{
+    auto pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+bool FileExists(const std::string& path)
+{
+    std::vector<cv::String> files;
+    cv::glob(path, files, false);
+    return !files.empty();
+}
+
+} // namespace
+
+StereoStream::StereoStream(const SgbmSolver& solver, size_t queue_capacity)
+    : solver(solver)
+    , decoded(queue_capacity)
+    , rectified(queue_capacity)
+    , disparity(queue_capacity)
+    , depth(queue_capacity)
+{
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        frame_count[i] = 0;
+        busy_us[i] = 0;
+    }
+}
+
+StereoStream::~StereoStream()
+{
+    Stop();
+}
+
+bool StereoStream::OpenFolders(const std::string& left_folder, const std::string& right_folder)
+{
+    image_pairs.clear();
+    video_path.clear();
+
+    std::vector<cv::String> left_files;
+    cv::glob(left_folder + "/*", left_files, false);
+    std::sort(left_files.begin(), left_files.end());
+
+    for (const auto& left_file : left_files)
+    {
+        std::string name = FileName(left_file);
+        auto pos = name.find("left");
+        if (pos == std::string::npos)
+            continue;
+
+        std::string right_file = right_folder + "/" + name.replace(pos, 4, "right");
+        if (!FileExists(right_file))
+        {
+            std::cout << right_file << ": no matching right image\n";
+            continue;
+        }
+
+        image_pairs.emplace_back(left_file, right_file);
+    }
+
+    return !image_pairs.empty();
+}
+
+bool StereoStream::OpenVideo(const std::string& video_path)
+{
+    image_pairs.clear();
+    this->video_path = video_path;
+
+    return cv::VideoCapture(video_path).isOpened();
+}
+
+void StereoStream::Start(const PublishFunc& func)
+{
+    if (running)
+        return;
+
+    publish_func = func;
+    running = true;
+
+    workers.emplace_back([this]() { DecodeStage(); });
+    workers.emplace_back([this]() {
+        RunStage(RECTIFY, decoded, &rectified,
+                 [this](StereoFrame& frame) { solver.Rectify(frame); });
+    });
+    workers.emplace_back([this]() {
+        RunStage(DISPARITY, rectified, &disparity,
+                 [this](StereoFrame& frame) { solver.ComputeDisparity(frame); });
+    });
+    workers.emplace_back([this]() {
+        RunStage(DEPTH, disparity, &depth, [this](StereoFrame& frame) {
+            // normalized depth changes scale with the disparity range of each frame,
+            // metric depth is kept to the solver's working range
+            if (pose_func)
+                solver.ComputeMetricDepth(frame);
+            else
+                solver.ComputeDepth(frame);
+            solver.FillDepth(frame);
+        });
+    });
+    workers.emplace_back([this]() {
+        RunStage(REPROJECT, depth, nullptr, [this](StereoFrame& frame) {
+            WinBoundary bound;
+            auto model = solver.Reproject(frame, bound);
+
+            if (pose_func)
+            {
+                // camera coordinates would land anywhere in the world cloud
+                Eigen::Isometry3d pose;
+                if (!pose_func(frame, pose))
+                {
+                    ++dropped_frames;
+                    return;
+                }
+                bound = WinBoundary();
+                TransformModel(model, pose, bound);
+            }
+
+            if (publish_func)
+                publish_func(std::move(model), bound);
+        });
+    });
+}
+
+void StereoStream::Wait()
+{
+    for (auto& worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    if (!workers.empty())
+        PrintReport();
+
+    workers.clear();
+    running = false;
+}
+
+void StereoStream::Stop()
+{
+    running = false;
+    decoded.Close();
+    rectified.Close();
+    disparity.Close();
+    depth.Close();
+
+    Wait();
+}
+
+void StereoStream::DecodeStage()
+{
+    TRACE_THREAD_NAME(stage_name[DECODE]);
+    auto push = [this](FramePtr frame, std::chrono::steady_clock::time_point start) {
+        busy_us[DECODE] += std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+        ++frame_count[DECODE];
+        return decoded.Push(std::move(frame));
+    };
+
+    if (!video_path.empty())
+    {
+        cv::VideoCapture capture(video_path);
+        cv::Mat img;
+        while (running)
+        {
+            TRACE_SCOPE("decode");
+            auto start = std::chrono::steady_clock::now();
+            if (!capture.read(img) || img.empty())
+                break;
+
+            const int half = img.cols / 2;
+            FramePtr frame(new StereoFrame);
+            frame->left_color = img(cv::Rect(0, 0, half, img.rows)).clone();
+            cv::cvtColor(img(cv::Rect(half, 0, half, img.rows)), frame->right, cv::COLOR_BGR2GRAY);
+            if (!push(std::move(frame), start))
+                break;
+        }
+    }
+    else
+    {
+        for (const auto& pair : image_pairs)
+        {
+            if (!running)
+                break;
+
+            TRACE_SCOPE("decode");
+            auto start = std::chrono::steady_clock::now();
+            FramePtr frame(new StereoFrame);
+            frame->left_color = cv::imread(pair.first);
+            frame->right = cv::imread(pair.second, cv::IMREAD_GRAYSCALE);
+            if (frame->left_color.empty() || frame->right.empty())
+            {
+                std::cout << pair.first << ": read image fail\n";
+                continue;
+            }
+
+            if (!push(std::move(frame), start))
+                break;
+        }
+    }
+
+    decoded.Close();
+}
+
+void StereoStream::RunStage(Stage stage, FrameQueue& in, FrameQueue* out,
+                            const std::function<void(StereoFrame&)>& func)
+{
+    TRACE_THREAD_NAME(stage_name[stage]);
+    FramePtr frame;
+    while (in.Pop(frame))
+    {
+        TRACE_SCOPE(stage_name[stage]);
+        auto start = std::chrono::steady_clock::now();
+        func(*frame);
+        busy_us[stage] += std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+        ++frame_count[stage];
+
+        if (out && !out->Push(std::move(frame)))
+            break;
+    }
+
+    // wake up the stages around, whether finished or stopped
+    in.Close();
+    if (out)
+        out->Close();
+}
+
+void StereoStream::PrintReport() const
+{
+    std::cout << "--- stereo stream ---\n";
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const size_t count = frame_count[i];
+        std::cout << stage_name[i] << ":\t" << count << " frames, "
+                  << (count ? busy_us[i] / 1000.0 / count : 0.0) << " ms/frame\n";
+    }
+    if (dropped_frames)
+        std::cout << "dropped without a pose: " << dropped_frames << " frames\n";
+    MemoryTracker::Instance().Print(std::cout);
+}
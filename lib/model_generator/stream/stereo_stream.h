@@ -0,0 +1,74 @@
+#pragma once
+#include "concurrent/bounded_queue.h"
+#include "math/rigid_transform.h"
+#include "model_generator/disparity/sgbm_solver.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// decode -> rectify -> sgbm -> depth -> reproject, one thread per stage
+class StereoStream
+{
+public:
+    using PublishFunc = std::function<void(Model&&, const WinBoundary&)>;
+    // camera -> world of a reprojected frame, false drops the frame unpublished
+    using PoseFunc = std::function<bool(const StereoFrame&, Eigen::Isometry3d&)>;
+
+public:
+    StereoStream(const SgbmSolver& solver, size_t queue_capacity = 2);
+    ~StereoStream();
+
+    // left_xx in left_folder pairs with right_xx in right_folder
+    bool OpenFolders(const std::string& left_folder, const std::string& right_folder);
+    // side by side video, left half | right half
+    bool OpenVideo(const std::string& video_path);
+
+    // set before Start, called in frame order from the reproject stage.
+    // frames are reprojected from metric depth then, in the baseline units poses use
+    void SetPoseFunc(const PoseFunc& func) { pose_func = func; }
+
+    void Start(const PublishFunc& func);
+    // blocks until every frame is published
+    void Wait();
+    void Stop();
+
+    bool Running() const { return running; }
+
+private:
+    using FramePtr = std::unique_ptr<StereoFrame>;
+    using FrameQueue = BoundedQueue<FramePtr>;
+
+    enum Stage
+    {
+        DECODE,
+        RECTIFY,
+        DISPARITY,
+        DEPTH,
+        REPROJECT,
+
+        STAGE_COUNT
+    };
+
+    void DecodeStage();
+    void RunStage(Stage stage, FrameQueue& in, FrameQueue* out,
+                  const std::function<void(StereoFrame&)>& func);
+    void PrintReport() const;
+
+private:
+    const SgbmSolver& solver;
+    PublishFunc publish_func;
+    PoseFunc pose_func;
+
+    std::vector<std::pair<std::string, std::string>> image_pairs;
+    std::string video_path;
+
+    FrameQueue decoded, rectified, disparity, depth;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{false};
+
+    std::atomic<size_t> frame_count[STAGE_COUNT];
+    std::atomic<long long> busy_us[STAGE_COUNT];
+    size_t dropped_frames = 0; // reproject stage only
+};
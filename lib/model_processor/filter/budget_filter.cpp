@@ -0,0 +1,80 @@
+#include "budget_filter.h"
+#include "profiling/memory_tracker.h"
+#include "voxel_filter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+
+constexpr int max_rounds = 8;
+
+size_t Bytes(const Model& model)
+{
+    return model.size() * sizeof(ModelVertex);
+}
+
+} // namespace
+
+BudgetFilter::BudgetFilter(double leaf_size, size_t max_bytes)
+    : leaf_size(leaf_size)
+    , max_bytes(max_bytes)
+{
+}
+
+size_t BudgetFilter::TargetBytes(size_t input_bytes) const
+{
+    if (max_bytes)
+        return max_bytes;
+
+    const MemoryTracker& tracker = MemoryTracker::Instance();
+    if (!tracker.Budget())
+        return SIZE_MAX;
+
+    // the input is counted as live but its bytes go back once the result replaces it
+    const size_t others = tracker.TotalLive() > input_bytes ? tracker.TotalLive() - input_bytes : 0;
+    return tracker.Budget() > others ? tracker.Budget() - others : 0;
+}
+
+Model BudgetFilter::Filter(const Model& model, WinBoundary& bound,
+                           FilterReport* report) const
+{
+    auto start = std::chrono::steady_clock::now();
+    const size_t target = TargetBytes(Bytes(model));
+
+    WinBoundary res_bound;
+    Model res = VoxelFilter(leaf_size).Filter(model, res_bound);
+
+    // points of a surface fall with the square of the leaf, coarser grids run on the last result
+    double leaf = leaf_size;
+    for (int round = 0; round < max_rounds && leaf > 0 && Bytes(res) > target; ++round)
+    {
+        leaf *= std::min(4.0, std::max(1.25, std::sqrt(static_cast<double>(Bytes(res)) / std::max<size_t>(target, 1))));
+
+        const size_t last_size = res.size();
+        res_bound = WinBoundary();
+        res = VoxelFilter(leaf).Filter(res, res_bound);
+        if (res.size() == last_size)
+            break;
+    }
+
+    if (leaf != leaf_size)
+        std::cout << "budget filter: " << Bytes(model) << " -> " << Bytes(res)
+                  << " bytes of " << target << ", leaf " << leaf_size << " -> " << leaf << "\n";
+
+    bound.Extend(res_bound);
+
+    if (report)
+    {
+        report->input_count = model.size();
+        report->output_count = res.size();
+        report->ratio = model.empty() ? 1.0 : static_cast<double>(res.size()) / model.size();
+        report->elapsed_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+    }
+
+    return res;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include "filter_report.h"
+
+// voxel filter with leaf_size, the leaf grows until the result fits max_bytes.
+// max_bytes 0 fits what the MemoryTracker budget leaves once the input is replaced
+class BudgetFilter
+{
+public:
+    BudgetFilter(double leaf_size, size_t max_bytes = 0);
+
+    Model Filter(const Model& model, WinBoundary& bound,
+                 FilterReport* report = nullptr) const;
+
+    // bytes the result may take for an input of input_bytes
+    size_t TargetBytes(size_t input_bytes) const;
+
+private:
+    const double leaf_size;
+    const size_t max_bytes;
+};
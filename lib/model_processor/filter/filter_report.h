@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+struct FilterReport
+{
+    size_t input_count = 0;
+    size_t output_count = 0;
+    double ratio = 1.0; // output / input
+    double elapsed_ms = 0.0;
+};
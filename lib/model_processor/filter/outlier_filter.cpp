@@ -0,0 +1,118 @@
+#include "outlier_filter.h"
+#include "concurrent/parallel_for.h"
+#include "model_processor/search/point_grid.h"
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+Model Keep(const Model& model, const std::vector<char>& keep, WinBoundary& bound,
+           FilterReport* report, std::chrono::steady_clock::time_point start)
+{
+    Model res;
+    res.reserve(model.size());
+    for (size_t i = 0; i < model.size(); ++i)
+    {
+        if (!keep[i])
+            continue;
+        res.push_back(model[i]);
+        bound.Extend(model[i].pos);
+    }
+
+    if (report)
+    {
+        report->input_count = model.size();
+        report->output_count = res.size();
+        report->ratio = model.empty() ? 1.0 : static_cast<double>(res.size()) / model.size();
+        report->elapsed_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+    }
+
+    return res;
+}
+
+} // namespace
+
+StatisticalOutlierFilter::StatisticalOutlierFilter(int k, double std_ratio, double search_radius)
+    : k(k)
+    , std_ratio(std_ratio)
+    , search_radius(search_radius)
+{
+}
+
+Model StatisticalOutlierFilter::Filter(const Model& model, WinBoundary& bound,
+                                       FilterReport* report) const
+{
+    auto start = std::chrono::steady_clock::now();
+    const PointGrid grid(model, search_radius);
+
+    // mean neighbor distance, negative when a point has no neighbor at all
+    std::vector<double> mean_dist(model.size());
+    const int threads = ThreadCount();
+    std::vector<double> sums(threads, 0.0), sums2(threads, 0.0);
+    std::vector<size_t> counts(threads, 0);
+    ParallelFor(0, model.size(), [&](size_t begin, size_t end, int id) {
+        std::vector<PointGrid::Neighbor> neighbors;
+        for (size_t i = begin; i < end; ++i)
+        {
+            grid.KNearest(model[i].pos, k, search_radius, neighbors, i);
+            if (neighbors.empty())
+            {
+                mean_dist[i] = -1.0;
+                continue;
+            }
+
+            double dist = 0.0;
+            for (const auto& neighbor : neighbors)
+                dist += std::sqrt(neighbor.first);
+            dist /= neighbors.size();
+
+            mean_dist[i] = dist;
+            sums[id] += dist;
+            sums2[id] += dist * dist;
+            ++counts[id];
+        }
+    },
+                threads);
+
+    double sum = 0.0, sum2 = 0.0;
+    size_t count = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        sum += sums[i];
+        sum2 += sums2[i];
+        count += counts[i];
+    }
+    const double mean = count ? sum / count : 0.0;
+    const double stddev = count ? std::sqrt(std::max(0.0, sum2 / count - mean * mean)) : 0.0;
+    const double threshold = mean + std_ratio * stddev;
+
+    std::vector<char> keep(model.size());
+    for (size_t i = 0; i < model.size(); ++i)
+        keep[i] = mean_dist[i] >= 0 && mean_dist[i] <= threshold;
+
+    return Keep(model, keep, bound, report, start);
+}
+
+RadiusOutlierFilter::RadiusOutlierFilter(double radius, int min_neighbors)
+    : radius(radius)
+    , min_neighbors(min_neighbors)
+{
+}
+
+Model RadiusOutlierFilter::Filter(const Model& model, WinBoundary& bound,
+                                  FilterReport* report) const
+{
+    auto start = std::chrono::steady_clock::now();
+    const PointGrid grid(model, radius);
+
+    std::vector<char> keep(model.size());
+    ParallelFor(0, model.size(), [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            keep[i] = grid.RadiusCount(model[i].pos, radius, i) >= static_cast<size_t>(min_neighbors);
+    });
+
+    return Keep(model, keep, bound, report, start);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include "filter_report.h"
+
+// drops points whose mean distance to their k nearest neighbors is more
+// than std_ratio deviations above the cloud average, neighbors are looked
+// up within search_radius
+class StatisticalOutlierFilter
+{
+public:
+    StatisticalOutlierFilter(int k, double std_ratio, double search_radius);
+
+    Model Filter(const Model& model, WinBoundary& bound,
+                 FilterReport* report = nullptr) const;
+
+private:
+    const int k;
+    const double std_ratio;
+    const double search_radius;
+};
+
+// drops points with fewer than min_neighbors other points within radius
+class RadiusOutlierFilter
+{
+public:
+    RadiusOutlierFilter(double radius, int min_neighbors);
+
+    Model Filter(const Model& model, WinBoundary& bound,
+                 FilterReport* report = nullptr) const;
+
+private:
+    const double radius;
+    const int min_neighbors;
+};
@@ -0,0 +1,117 @@
+#include "voxel_filter.h"
+#include "concurrent/parallel_for.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+
+constexpr int key_bits = 21;
+constexpr int64_t key_max = (int64_t(1) << key_bits) - 1;
+
+struct VoxelSum
+{
+    Eigen::Vector3d pos = Eigen::Vector3d::Zero();
+    int r = 0, g = 0, b = 0;
+    int count = 0;
+};
+
+} // namespace
+
+VoxelFilter::VoxelFilter(double leaf_size)
+    : leaf_size(leaf_size)
+{
+}
+
+Model VoxelFilter::Filter(const Model& model, WinBoundary& bound,
+                          FilterReport* report) const
+{
+    auto start = std::chrono::steady_clock::now();
+    const int threads = ThreadCount();
+
+    WinBoundary box;
+    for (const auto& vertex : model)
+        box.Extend(vertex.pos);
+
+    const Eigen::Vector3d extent = (box.wmax - box.wmin) / leaf_size;
+    if (model.empty() || leaf_size <= 0 || extent.maxCoeff() >= key_max)
+    {
+        std::cout << "voxel filter: leaf size " << leaf_size << " not usable\n";
+        for (const auto& vertex : model)
+            bound.Extend(vertex.pos);
+        return model;
+    }
+
+    // voxel key per point, indices bucketed by the thread owning their voxel
+    std::vector<uint64_t> keys(model.size());
+    std::vector<std::vector<std::vector<size_t>>> buckets(threads, std::vector<std::vector<size_t>>(threads));
+    ParallelFor(0, model.size(), [&](size_t begin, size_t end, int chunk) {
+        std::hash<uint64_t> hasher;
+        auto& chunk_buckets = buckets[chunk];
+        for (size_t i = begin; i < end; ++i)
+        {
+            const Eigen::Vector3d idx = (model[i].pos - box.wmin) / leaf_size;
+            keys[i] = uint64_t(idx.x()) |
+                      uint64_t(idx.y()) << key_bits |
+                      uint64_t(idx.z()) << (2 * key_bits);
+            chunk_buckets[hasher(keys[i]) % threads].push_back(i);
+        }
+    }, threads);
+
+    // each thread owns the voxels hashing to it, no locking on the maps.
+    // chunks are visited in order, so points keep their input order
+    std::vector<Model> parts(threads);
+    ParallelFor(0, threads, [&](size_t begin, size_t end, int) {
+        for (size_t part = begin; part < end; ++part)
+        {
+            std::unordered_map<uint64_t, VoxelSum> voxels;
+            for (const auto& chunk_buckets : buckets)
+            {
+                for (const size_t i : chunk_buckets[part])
+                {
+                    auto& sum = voxels[keys[i]];
+                    sum.pos += model[i].pos;
+                    sum.r += model[i].color.r;
+                    sum.g += model[i].color.g;
+                    sum.b += model[i].color.b;
+                    ++sum.count;
+                }
+            }
+
+            auto& out = parts[part];
+            out.reserve(voxels.size());
+            for (const auto& voxel : voxels)
+            {
+                const auto& sum = voxel.second;
+                out.push_back({sum.pos / sum.count,
+                               {sum.r / sum.count, sum.g / sum.count, sum.b / sum.count}});
+            }
+        }
+    });
+
+    Model res;
+    size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    res.reserve(total);
+    for (const auto& part : parts)
+    {
+        res.insert(res.end(), part.begin(), part.end());
+        for (const auto& vertex : part)
+            bound.Extend(vertex.pos);
+    }
+
+    if (report)
+    {
+        report->input_count = model.size();
+        report->output_count = res.size();
+        report->ratio = static_cast<double>(res.size()) / model.size();
+        report->elapsed_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+    }
+
+    return res;
+}
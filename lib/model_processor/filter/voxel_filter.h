@@ -0,0 +1,17 @@
+#pragma once
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include "filter_report.h"
+
+// one averaged vertex per occupied voxel of a leaf_size grid
+class VoxelFilter
+{
+public:
+    VoxelFilter(double leaf_size);
+
+    Model Filter(const Model& model, WinBoundary& bound,
+                 FilterReport* report = nullptr) const;
+
+private:
+    const double leaf_size;
+};
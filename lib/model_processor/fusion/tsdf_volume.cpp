@@ -0,0 +1,216 @@
+#include "tsdf_volume.h"
+#include "concurrent/parallel_for.h"
+#include <cmath>
+#include <unordered_set>
+
+namespace
+{
+
+int FloorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+TsdfVolume::TsdfVolume(double voxel_size, double truncation)
+    : voxel_size(voxel_size)
+    , truncation(truncation)
+{
+}
+
+void TsdfVolume::SetDepthRange(double min_depth, double max_depth)
+{
+    this->min_depth = min_depth;
+    this->max_depth = max_depth;
+}
+
+TsdfVolume::BlockKey TsdfVolume::KeyOf(const Eigen::Vector3d& pos) const
+{
+    const double block_size = voxel_size * block_dim;
+    return {static_cast<int>(std::floor(pos.x() / block_size)),
+            static_cast<int>(std::floor(pos.y() / block_size)),
+            static_cast<int>(std::floor(pos.z() / block_size))};
+}
+
+const TsdfVolume::Voxel* TsdfVolume::FindVoxel(int x, int y, int z) const
+{
+    const BlockKey key{FloorDiv(x, block_dim), FloorDiv(y, block_dim), FloorDiv(z, block_dim)};
+    auto iter = blocks.find(key);
+    if (iter == blocks.end())
+        return nullptr;
+
+    const int lx = x - key.x * block_dim, ly = y - key.y * block_dim, lz = z - key.z * block_dim;
+    return &iter->second.voxels[(lz * block_dim + ly) * block_dim + lx];
+}
+
+void TsdfVolume::Integrate(const cv::Mat& depth, const cv::Mat& color,
+                           const PinholeCamera& camera, const Eigen::Isometry3d& pose)
+{
+    CV_Assert(depth.type() == CV_32FC1);
+    const bool has_color = !color.empty() && color.size() == depth.size();
+
+    // blocks crossed by the truncation band around every depth sample
+    using KeySet = std::unordered_set<BlockKey, BlockKeyHash>;
+    const int threads = ThreadCount();
+    std::vector<KeySet> thread_keys(threads);
+    const double block_size = voxel_size * block_dim;
+    auto collect_keys = [&](size_t begin, size_t end, int id) {
+        auto& keys = thread_keys[id];
+        for (int v = static_cast<int>(begin); v < static_cast<int>(end); ++v)
+        {
+            const float* row = depth.ptr<float>(v);
+            for (int u = 0; u < depth.cols; ++u)
+            {
+                const double d = row[u];
+                if (d < min_depth || d > max_depth)
+                    continue;
+
+                const Eigen::Vector3d ray = camera.BackProject(u, v, 1.0);
+                for (double t = d - truncation; t < d + truncation + block_size * 0.5; t += block_size * 0.5)
+                    keys.insert(KeyOf(pose * (ray * t)));
+            }
+        }
+    };
+    ParallelFor(0, depth.rows, collect_keys, threads);
+
+    std::vector<std::pair<BlockKey, Block*>> visible;
+    {
+        KeySet keys;
+        for (const auto& part : thread_keys)
+            keys.insert(part.begin(), part.end());
+
+        visible.reserve(keys.size());
+        for (const auto& key : keys)
+            visible.emplace_back(key, &blocks[key]); // node based, pointers survive rehash
+    }
+
+    // a block belongs to one thread, its voxels are updated without locking
+    const Eigen::Isometry3d world_to_cam = pose.inverse();
+    auto update_blocks = [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const BlockKey& key = visible[i].first;
+            Block& block = *visible[i].second;
+            for (int z = 0; z < block_dim; ++z)
+            {
+                for (int y = 0; y < block_dim; ++y)
+                {
+                    for (int x = 0; x < block_dim; ++x)
+                    {
+                        const Eigen::Vector3d center(
+                            (key.x * block_dim + x + 0.5) * voxel_size,
+                            (key.y * block_dim + y + 0.5) * voxel_size,
+                            (key.z * block_dim + z + 0.5) * voxel_size);
+                        const Eigen::Vector3d pos = world_to_cam * center;
+                        if (pos.z() <= 0)
+                            continue;
+
+                        const Eigen::Vector2d pixel = camera.Project(pos);
+                        const int u = static_cast<int>(std::round(pixel.x()));
+                        const int v = static_cast<int>(std::round(pixel.y()));
+                        if (u < 0 || v < 0 || u >= depth.cols || v >= depth.rows)
+                            continue;
+
+                        const double d = depth.ptr<float>(v)[u];
+                        if (d < min_depth || d > max_depth)
+                            continue;
+
+                        // projective distance along the viewing axis
+                        const double sdf = d - pos.z();
+                        if (sdf < -truncation)
+                            continue;
+
+                        Voxel& voxel = block.voxels[(z * block_dim + y) * block_dim + x];
+                        const float tsdf = static_cast<float>(std::min(1.0, sdf / truncation));
+                        const float weight = voxel.weight + 1.0f;
+                        voxel.tsdf = (voxel.tsdf * voxel.weight + tsdf) / weight;
+                        if (has_color)
+                        {
+                            const uchar* bgr = color.ptr<uchar>(v) + 3 * u;
+                            voxel.b = (voxel.b * voxel.weight + bgr[0]) / weight;
+                            voxel.g = (voxel.g * voxel.weight + bgr[1]) / weight;
+                            voxel.r = (voxel.r * voxel.weight + bgr[2]) / weight;
+                        }
+                        voxel.weight = weight;
+                    }
+                }
+            }
+        }
+    };
+    ParallelFor(0, visible.size(), update_blocks, threads);
+}
+
+Model TsdfVolume::ExtractCloud(WinBoundary& bound) const
+{
+    std::vector<std::pair<const BlockKey*, const Block*>> all;
+    all.reserve(blocks.size());
+    for (const auto& block : blocks)
+        all.emplace_back(&block.first, &block.second);
+
+    const int threads = ThreadCount();
+    std::vector<Model> parts(threads);
+    auto extract = [&](size_t begin, size_t end, int id) {
+        auto& out = parts[id];
+        for (size_t i = begin; i < end; ++i)
+        {
+            const BlockKey& key = *all[i].first;
+            const Block& block = *all[i].second;
+            for (int z = 0; z < block_dim; ++z)
+            {
+                for (int y = 0; y < block_dim; ++y)
+                {
+                    for (int x = 0; x < block_dim; ++x)
+                    {
+                        const Voxel& voxel = block.voxels[(z * block_dim + y) * block_dim + x];
+                        if (voxel.weight <= 0)
+                            continue;
+
+                        const int gx = key.x * block_dim + x;
+                        const int gy = key.y * block_dim + y;
+                        const int gz = key.z * block_dim + z;
+                        const Eigen::Vector3d pos((gx + 0.5) * voxel_size,
+                                                  (gy + 0.5) * voxel_size,
+                                                  (gz + 0.5) * voxel_size);
+
+                        // edges towards +x, +y, +z, each crossing is found once
+                        const int offsets[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+                        for (const auto& o : offsets)
+                        {
+                            const Voxel* other = FindVoxel(gx + o[0], gy + o[1], gz + o[2]);
+                            if (!other || other->weight <= 0 ||
+                                (voxel.tsdf > 0) == (other->tsdf > 0))
+                                continue;
+
+                            const double t = voxel.tsdf / (voxel.tsdf - other->tsdf);
+                            const Eigen::Vector3d crossing =
+                                pos + t * voxel_size * Eigen::Vector3d(o[0], o[1], o[2]);
+                            out.push_back({crossing,
+                                           {static_cast<int>(voxel.r),
+                                            static_cast<int>(voxel.g),
+                                            static_cast<int>(voxel.b)}});
+                        }
+                    }
+                }
+            }
+        }
+    };
+    ParallelFor(0, all.size(), extract, threads);
+
+    Model model;
+    for (const auto& part : parts)
+    {
+        for (const auto& vertex : part)
+            bound.Extend(vertex.pos);
+        model.insert(model.end(), part.begin(), part.end());
+    }
+
+    return model;
+}
+
+size_t TsdfVolume::MemoryBytes() const
+{
+    // block payload plus key and bucket overhead of the hash map
+    return blocks.size() * (sizeof(Block) + sizeof(BlockKey) + 2 * sizeof(void*)) +
+           blocks.bucket_count() * sizeof(void*);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "def/model.h"
+#include "def/pinhole.h"
+#include "def/win_boundary.h"
+#include <Eigen/Geometry>
+#include <opencv2/core.hpp>
+#include <unordered_map>
+
+// truncated signed distance volume, only 8^3 voxel blocks near observed
+// surfaces are allocated, found through a hash of the block coordinate
+class TsdfVolume
+{
+public:
+    TsdfVolume(double voxel_size, double truncation);
+
+    // depth outside the range is ignored, e.g. the hole filled border
+    void SetDepthRange(double min_depth, double max_depth);
+
+    // depth CV_32F, color BGR of the same size or empty, pose camera -> world
+    void Integrate(const cv::Mat& depth, const cv::Mat& color,
+                   const PinholeCamera& camera, const Eigen::Isometry3d& pose);
+
+    // one vertex per zero crossing along the voxel edges
+    Model ExtractCloud(WinBoundary& bound) const;
+
+    size_t BlockCount() const { return blocks.size(); }
+    size_t MemoryBytes() const;
+
+private:
+    static constexpr int block_dim = 8;
+
+    struct Voxel
+    {
+        float tsdf = 1.0f;
+        float weight = 0.0f;
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+    };
+
+    struct Block
+    {
+        Voxel voxels[block_dim * block_dim * block_dim];
+    };
+
+    struct BlockKey
+    {
+        int x, y, z;
+        bool operator==(const BlockKey& other) const
+        {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct BlockKeyHash
+    {
+        size_t operator()(const BlockKey& key) const
+        {
+            return (size_t(key.x) * 73856093) ^ (size_t(key.y) * 19349663) ^ (size_t(key.z) * 83492791);
+        }
+    };
+
+    BlockKey KeyOf(const Eigen::Vector3d& pos) const;
+    const Voxel* FindVoxel(int x, int y, int z) const;
+
+private:
+    const double voxel_size;
+    const double truncation;
+    double min_depth = 0.0, max_depth = 1e10;
+
+    std::unordered_map<BlockKey, Block, BlockKeyHash> blocks;
+};
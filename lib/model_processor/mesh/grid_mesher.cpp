@@ -0,0 +1,129 @@
+#include "grid_mesher.h"
+#include "concurrent/parallel_for.h"
+#include <array>
+#include <cmath>
+
+GridMesher::GridMesher(double max_jump_ratio, int max_cell, double flat_tolerance)
+    : max_jump_ratio(max_jump_ratio)
+    , max_cell(std::max(1, max_cell))
+    , flat_tolerance(flat_tolerance)
+{
+}
+
+bool GridMesher::Flat(const OrganizedModel& model, int u0, int v0, int size) const
+{
+    if (!model.Inside(u0 + size, v0 + size))
+        return false;
+
+    // inverse depth of a plane is affine in pixel coordinates
+    const double i00 = 1.0 / model.At(u0, v0).pos.z();
+    const double i10 = 1.0 / model.At(u0 + size, v0).pos.z();
+    const double i01 = 1.0 / model.At(u0, v0 + size).pos.z();
+    const double i11 = 1.0 / model.At(u0 + size, v0 + size).pos.z();
+
+    for (int v = v0; v <= v0 + size; ++v)
+    {
+        for (int u = u0; u <= u0 + size; ++u)
+        {
+            if (!model.Valid(u, v))
+                return false;
+
+            const double a = double(u - u0) / size, b = double(v - v0) / size;
+            const double inv = (1 - a) * (1 - b) * i00 + a * (1 - b) * i10 +
+                               (1 - a) * b * i01 + a * b * i11;
+            const double z = model.At(u, v).pos.z();
+            if (std::abs(1.0 / inv - z) > flat_tolerance)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void GridMesher::AddQuad(const OrganizedModel& model, int u, int v, int size,
+                         std::vector<PixelFace>& faces) const
+{
+    auto add = [&](int ua, int va, int ub, int vb, int uc, int vc) {
+        if (!model.Valid(ua, va) || !model.Valid(ub, vb) || !model.Valid(uc, vc))
+            return;
+
+        const double za = model.At(ua, va).pos.z();
+        const double zb = model.At(ub, vb).pos.z();
+        const double zc = model.At(uc, vc).pos.z();
+        const double zmin = std::min(za, std::min(zb, zc));
+        const double zmax = std::max(za, std::max(zb, zc));
+        if (zmax - zmin > max_jump_ratio * zmin)
+            return;
+
+        faces.push_back({model.Index(ua, va), model.Index(ub, vb), model.Index(uc, vc)});
+    };
+
+    // (u, v) (u, v + 1) (u + 1, v) faces -z, the camera
+    add(u, v, u, v + size, u + size, v);
+    add(u + size, v, u, v + size, u + size, v + size);
+}
+
+void GridMesher::AddCell(const OrganizedModel& model, int u0, int v0, int size,
+                         std::vector<PixelFace>& faces) const
+{
+    if (u0 >= model.width - 1 || v0 >= model.height - 1)
+        return;
+
+    if (size == 1 || Flat(model, u0, v0, size))
+    {
+        AddQuad(model, u0, v0, size, faces);
+        return;
+    }
+
+    const int half = size / 2;
+    AddCell(model, u0, v0, half, faces);
+    AddCell(model, u0 + half, v0, half, faces);
+    AddCell(model, u0, v0 + half, half, faces);
+    AddCell(model, u0 + half, v0 + half, half, faces);
+}
+
+Mesh GridMesher::Triangulate(const OrganizedModel& model, WinBoundary& bound) const
+{
+    // round the cell size down to a power of two so cells split evenly
+    int cell = 1;
+    while (cell * 2 <= max_cell)
+        cell *= 2;
+
+    const int tile_rows = (model.height - 1 + cell - 1) / cell;
+    const int tile_cols = (model.width - 1 + cell - 1) / cell;
+    const int threads = ThreadCount();
+    std::vector<std::vector<PixelFace>> thread_faces(threads);
+    auto mesh_tiles = [&](size_t begin, size_t end, int id) {
+        for (int t = static_cast<int>(begin); t < static_cast<int>(end); ++t)
+        {
+            for (int c = 0; c < tile_cols; ++c)
+                AddCell(model, c * cell, t * cell, cell, thread_faces[id]);
+        }
+    };
+    ParallelFor(0, std::max(0, tile_rows), mesh_tiles, threads);
+
+    // keep only the pixels some face uses
+    Mesh mesh;
+    std::vector<int> vertex_id(model.vertex.size(), -1);
+    for (const auto& faces : thread_faces)
+    {
+        for (const auto& pixel_face : faces)
+        {
+            Eigen::Vector3i face;
+            for (int i = 0; i < 3; ++i)
+            {
+                int& id = vertex_id[pixel_face[i]];
+                if (id < 0)
+                {
+                    id = static_cast<int>(mesh.vertex.size());
+                    mesh.vertex.push_back(model.vertex[pixel_face[i]]);
+                    bound.Extend(mesh.vertex.back().pos);
+                }
+                face(i) = id;
+            }
+            mesh.face.push_back(face);
+        }
+    }
+
+    return mesh;
+}
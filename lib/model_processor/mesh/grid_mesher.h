@@ -0,0 +1,32 @@
+#pragma once
+#include "def/mesh.h"
+#include "def/organized_model.h"
+#include "def/win_boundary.h"
+#include <array>
+
+// triangulates an organized model along its pixel grid. two triangles per
+// pixel quad, dropped where the depth jumps by more than max_jump_ratio * depth.
+// with max_cell > 1 flat regions are merged into quadtree cells of up to
+// max_cell pixels whose inverse depth is bilinear within flat_tolerance (depth units),
+// edges between cells of different size may leave small cracks
+class GridMesher
+{
+public:
+    GridMesher(double max_jump_ratio = 0.05, int max_cell = 1, double flat_tolerance = 0.05);
+
+    Mesh Triangulate(const OrganizedModel& model, WinBoundary& bound) const;
+
+private:
+    using PixelFace = std::array<size_t, 3>;
+
+    bool Flat(const OrganizedModel& model, int u0, int v0, int size) const;
+    void AddCell(const OrganizedModel& model, int u0, int v0, int size,
+                 std::vector<PixelFace>& faces) const;
+    void AddQuad(const OrganizedModel& model, int u, int v, int size,
+                 std::vector<PixelFace>& faces) const;
+
+private:
+    const double max_jump_ratio;
+    const int max_cell;
+    const double flat_tolerance;
+};
@@ -0,0 +1,154 @@
+#include "stereo_odometry.h"
+#include <chrono>
+#include <cmath>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+namespace
+{
+
+const cv::Size lk_window(21, 21);
+constexpr int lk_levels = 3;
+
+// rectified rows of a stereo match, and the smallest disparity worth a depth
+constexpr float max_row_error = 1.5f;
+constexpr float min_disparity = 1.0f;
+
+constexpr int min_inliers = 12;
+// frames tracked against the last good landmarks before tracking restarts at the stale pose
+constexpr int max_lost_frames = 5;
+constexpr int ransac_iterations = 100;
+constexpr float ransac_reprojection_error = 2.0f;
+
+} // namespace
+
+StereoOdometry::StereoOdometry(const PinholeCamera& camera, double baseline, int max_features)
+    : camera(camera)
+    , baseline(baseline)
+    , max_features(max_features)
+    , pose(Eigen::Isometry3d::Identity())
+{
+}
+
+void StereoOdometry::Reset()
+{
+    prev_left.release();
+    prev_pixels.clear();
+    prev_points.clear();
+    pose.setIdentity();
+    lost_frames = 0;
+}
+
+void StereoOdometry::Triangulate(const cv::Mat& left, const cv::Mat& right)
+{
+    prev_left = left;
+    prev_pixels.clear();
+    prev_points.clear();
+
+    std::vector<cv::Point2f> corners;
+    cv::goodFeaturesToTrack(left, corners, max_features, 0.01, 10);
+    if (corners.empty())
+        return;
+
+    std::vector<cv::Point2f> right_corners;
+    std::vector<uchar> status;
+    std::vector<float> error;
+    cv::calcOpticalFlowPyrLK(left, right, corners, right_corners, status, error, lk_window, lk_levels);
+
+    for (size_t i = 0; i < corners.size(); ++i)
+    {
+        const float disparity = corners[i].x - right_corners[i].x;
+        if (!status[i] || std::abs(corners[i].y - right_corners[i].y) > max_row_error || disparity < min_disparity)
+            continue;
+
+        const Eigen::Vector3d pos = pose * camera.BackProject(corners[i].x, corners[i].y,
+                                                               camera.fx * baseline / disparity);
+        prev_pixels.push_back(corners[i]);
+        prev_points.emplace_back(pos.x(), pos.y(), pos.z());
+    }
+}
+
+bool StereoOdometry::Track(const cv::Mat& left, const cv::Mat& right, OdometryReport* report)
+{
+    auto start = std::chrono::steady_clock::now();
+    OdometryReport stats;
+
+    bool tracked = true;
+    if (!prev_pixels.empty())
+    {
+        std::vector<cv::Point2f> pixels;
+        std::vector<uchar> status;
+        std::vector<float> error;
+        cv::calcOpticalFlowPyrLK(prev_left, left, prev_pixels, pixels, status, error, lk_window, lk_levels);
+
+        std::vector<cv::Point3f> object_points;
+        std::vector<cv::Point2f> image_points;
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            if (!status[i])
+                continue;
+
+            object_points.push_back(prev_points[i]);
+            image_points.push_back(pixels[i]);
+        }
+        stats.tracked = image_points.size();
+
+        tracked = false;
+        if (stats.tracked >= min_inliers)
+        {
+            const cv::Matx33d K(camera.fx, 0, camera.cx,
+                                0, camera.fy, camera.cy,
+                                0, 0, 1);
+
+            // the last pose is the initial guess, world -> camera
+            const Eigen::Isometry3d world_to_cam = pose.inverse();
+            cv::Matx33d R;
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c)
+                    R(r, c) = world_to_cam.linear()(r, c);
+            cv::Mat rvec, tvec = (cv::Mat_<double>(3, 1) << world_to_cam.translation().x(),
+                                  world_to_cam.translation().y(),
+                                  world_to_cam.translation().z());
+            cv::Rodrigues(R, rvec);
+
+            std::vector<int> inliers;
+            if (cv::solvePnPRansac(object_points, image_points, K, cv::noArray(), rvec, tvec, true,
+                                   ransac_iterations, ransac_reprojection_error, 0.99, inliers) &&
+                static_cast<int>(inliers.size()) >= min_inliers)
+            {
+                cv::Mat rotation;
+                cv::Rodrigues(rvec, rotation);
+
+                Eigen::Isometry3d solved = Eigen::Isometry3d::Identity();
+                for (int r = 0; r < 3; ++r)
+                {
+                    for (int c = 0; c < 3; ++c)
+                        solved.linear()(r, c) = rotation.at<double>(r, c);
+                    solved.translation()(r) = tvec.at<double>(r);
+                }
+
+                pose = solved.inverse();
+                stats.inliers = inliers.size();
+                tracked = true;
+            }
+        }
+    }
+
+    // fresh landmarks every frame keep the tracks short and the cost fixed. a lost
+    // frame keeps the last good ones, landmarks anchored at a stale pose would pass
+    // its error on to every later frame
+    lost_frames = tracked ? 0 : lost_frames + 1;
+    if (tracked || lost_frames > max_lost_frames)
+    {
+        Triangulate(left, right);
+        lost_frames = 0;
+    }
+    stats.landmarks = prev_points.size();
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (report)
+        *report = stats;
+
+    return tracked;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "def/pinhole.h"
+#include <Eigen/Geometry>
+#include <opencv2/core.hpp>
+#include <vector>
+
+struct OdometryReport
+{
+    size_t tracked = 0;   // landmarks found again in the new left image
+    size_t inliers = 0;   // pnp inliers among them
+    size_t landmarks = 0; // triangulated for the next frame
+    double elapsed_ms = 0.0;
+};
+
+// frame to frame pose of a rectified stereo rig. corners of the left image are triangulated
+// against the right image with the rig baseline, tracked into the next left image with
+// pyramidal lk and the new pose is solved by pnp ransac. max_features bounds the work per frame
+class StereoOdometry
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    StereoOdometry(const PinholeCamera& camera, double baseline, int max_features = 400);
+
+    // rectified gray images of the next frame. false when tracking is lost, the last
+    // pose is kept and the next frames are tracked against the last tracked one.
+    // after a few lost frames in a row tracking restarts at the last pose
+    bool Track(const cv::Mat& left, const cv::Mat& right, OdometryReport* report = nullptr);
+
+    // camera -> world, the world is the first frame's left camera
+    const Eigen::Isometry3d& Pose() const { return pose; }
+    void Reset();
+
+private:
+    void Triangulate(const cv::Mat& left, const cv::Mat& right);
+
+private:
+    const PinholeCamera camera;
+    const double baseline;
+    const int max_features;
+
+    cv::Mat prev_left;
+    std::vector<cv::Point2f> prev_pixels;
+    std::vector<cv::Point3f> prev_points; // world
+    Eigen::Isometry3d pose;
+    int lost_frames = 0; // in a row
+};
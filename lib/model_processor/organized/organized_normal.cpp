@@ -0,0 +1,86 @@
+#include "organized_normal.h"
+#include "concurrent/parallel_for.h"
+#include <Eigen/Geometry>
+#include <cmath>
+
+namespace
+{
+
+// central difference along one axis, one sided at borders and depth jumps
+bool GridTangent(const OrganizedModel& model, int u, int v, int du, int dv,
+                 double max_jump, Eigen::Vector3d& tangent)
+{
+    const Eigen::Vector3d& center = model.At(u, v).pos;
+    auto usable = [&](int x, int y) {
+        return model.Valid(x, y) && std::abs(model.At(x, y).pos.z() - center.z()) <= max_jump;
+    };
+
+    const bool next = usable(u + du, v + dv);
+    const bool prev = usable(u - du, v - dv);
+    if (next && prev)
+        tangent = model.At(u + du, v + dv).pos - model.At(u - du, v - dv).pos;
+    else if (next)
+        tangent = model.At(u + du, v + dv).pos - center;
+    else if (prev)
+        tangent = center - model.At(u - du, v - dv).pos;
+    else
+        return false;
+
+    return true;
+}
+
+} // namespace
+
+void ComputeGridNormals(OrganizedModel& model, double max_jump)
+{
+    model.normal.assign(model.vertex.size(), Eigen::Vector3d::Zero());
+
+    ParallelFor(0, model.height, [&](size_t begin, size_t end, int) {
+        for (int v = static_cast<int>(begin); v < static_cast<int>(end); ++v)
+        {
+            for (int u = 0; u < model.width; ++u)
+            {
+                if (!model.Valid(u, v))
+                    continue;
+
+                Eigen::Vector3d tu, tv;
+                if (!GridTangent(model, u, v, 1, 0, max_jump, tu) ||
+                    !GridTangent(model, u, v, 0, 1, max_jump, tv))
+                    continue;
+
+                Eigen::Vector3d n = tu.cross(tv);
+                const double norm = n.norm();
+                if (norm < 1e-12)
+                    continue;
+
+                n /= norm;
+                if (n.dot(model.At(u, v).pos) > 0)
+                    n = -n;
+                model.normal[model.Index(u, v)] = n;
+            }
+        }
+    });
+}
+
+size_t DropGrazingVertex(OrganizedModel& model, double min_cos)
+{
+    if (model.normal.size() != model.vertex.size())
+        return 0;
+
+    size_t dropped = 0;
+    for (size_t i = 0; i < model.vertex.size(); ++i)
+    {
+        if (!model.valid[i])
+            continue;
+
+        const Eigen::Vector3d& pos = model.vertex[i].pos;
+        const Eigen::Vector3d& n = model.normal[i];
+        if (n.isZero() || std::abs(n.dot(pos)) < min_cos * pos.norm())
+        {
+            model.valid[i] = 0;
+            ++dropped;
+        }
+    }
+
+    return dropped;
+}
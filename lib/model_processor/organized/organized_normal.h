@@ -0,0 +1,12 @@
+#pragma once
+#include "def/organized_model.h"
+
+// per pixel normals from the grid neighbours, no spatial index needed.
+// neighbours further than max_jump in depth are treated as another surface,
+// normals face the camera at the origin, zero where none can be formed
+void ComputeGridNormals(OrganizedModel& model, double max_jump);
+
+// invalidates vertex seen at a grazing angle, where |normal . view ray| < min_cos,
+// and vertex without a normal. these are mostly the flying pixels stretched across
+// depth jumps. needs ComputeGridNormals first, returns the number dropped
+size_t DropGrazingVertex(OrganizedModel& model, double min_cos);
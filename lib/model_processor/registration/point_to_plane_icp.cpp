@@ -0,0 +1,206 @@
+#include "point_to_plane_icp.h"
+#include "concurrent/parallel_for.h"
+#include "model_processor/filter/voxel_filter.h"
+#include "model_processor/search/point_grid.h"
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+using Vector6d = Eigen::Matrix<double, 6, 1>;
+using Matrix6d = Eigen::Matrix<double, 6, 6>;
+
+struct Normals
+{
+    std::vector<Eigen::Vector3d> normal;
+    std::vector<char> valid;
+};
+
+// per thread normal equations of the point to plane residuals
+struct Reduction
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Matrix6d JtJ = Matrix6d::Zero();
+    Vector6d Jtr = Vector6d::Zero();
+    double sq_error = 0.0;
+    size_t count = 0;
+};
+
+double Elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// smallest principal axis of the k nearest neighbors
+Normals EstimateNormals(const Model& model, const PointGrid& grid, int k, double radius, int threads)
+{
+    Normals normals;
+    normals.normal.resize(model.size(), Eigen::Vector3d::Zero());
+    normals.valid.resize(model.size(), 0);
+
+    ParallelFor(0, model.size(), [&](size_t begin, size_t end, int) {
+        std::vector<PointGrid::Neighbor> neighbors;
+        for (size_t i = begin; i < end; ++i)
+        {
+            grid.KNearest(model[i].pos, k, radius, neighbors);
+            if (neighbors.size() < 3)
+                continue;
+
+            Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+            for (const auto& neighbor : neighbors)
+                mean += model[neighbor.second].pos;
+            mean /= neighbors.size();
+
+            Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+            for (const auto& neighbor : neighbors)
+            {
+                const Eigen::Vector3d d = model[neighbor.second].pos - mean;
+                cov += d * d.transpose();
+            }
+
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov);
+            normals.normal[i] = solver.eigenvectors().col(0);
+            normals.valid[i] = 1;
+        }
+    },
+                threads);
+
+    return normals;
+}
+
+} // namespace
+
+PointToPlaneIcp::PointToPlaneIcp(const IcpParams& params)
+    : params(params)
+{
+}
+
+Eigen::Isometry3d PointToPlaneIcp::Align(const Model& source, const Model& target,
+                                         const Eigen::Isometry3d& initial, IcpReport* report) const
+{
+    auto start = std::chrono::steady_clock::now();
+    const int threads = params.threads > 0 ? params.threads : ThreadCount();
+
+    IcpReport stats;
+    Eigen::Isometry3d transform = initial;
+    std::vector<double> levels = params.voxel_levels;
+    if (levels.empty())
+        levels.push_back(0.0);
+
+    // pyramid built fine to coarse, each level filters the finer one instead of the full cloud
+    std::vector<Model> source_levels(levels.size()), target_levels(levels.size());
+    for (size_t l = levels.size(); l-- > 0;)
+    {
+        const bool finest = l + 1 == levels.size();
+        const Model& source_finer = finest ? source : source_levels[l + 1];
+        const Model& target_finer = finest ? target : target_levels[l + 1];
+        if (levels[l] <= 0)
+        {
+            source_levels[l] = source_finer;
+            target_levels[l] = target_finer;
+            continue;
+        }
+
+        WinBoundary source_bound, target_bound;
+        source_levels[l] = VoxelFilter(levels[l]).Filter(source_finer, source_bound);
+        target_levels[l] = VoxelFilter(levels[l]).Filter(target_finer, target_bound);
+    }
+
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        auto level_start = std::chrono::steady_clock::now();
+        const double leaf = levels[l];
+        const Model& source_level = source_levels[l];
+        const Model& target_level = target_levels[l];
+
+        IcpLevelReport level;
+        level.leaf = leaf;
+        level.source_count = source_level.size();
+        level.target_count = target_level.size();
+        if (source_level.empty() || target_level.empty())
+            break;
+
+        // the full clouds have no leaf, their spacing is taken from the finest level before
+        const double spacing = leaf > 0 ? leaf : (stats.levels.empty() ? 1.0 : stats.levels.back().leaf / 2);
+        const double max_distance = params.max_distance_ratio * spacing;
+
+        const PointGrid grid(target_level, max_distance);
+        const Normals normals = EstimateNormals(target_level, grid, params.normal_k, max_distance, threads);
+
+        std::vector<Reduction, Eigen::aligned_allocator<Reduction>> reductions(threads);
+        for (int iter = 0; iter < params.max_iterations; ++iter)
+        {
+            for (auto& reduction : reductions)
+                reduction = Reduction();
+
+            ParallelFor(0, source_level.size(), [&](size_t begin, size_t end, int id) {
+                Reduction& reduction = reductions[id];
+                PointGrid::Neighbor nearest;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const Eigen::Vector3d p = transform * source_level[i].pos;
+                    if (!grid.Nearest(p, max_distance, nearest) || !normals.valid[nearest.second])
+                        continue;
+
+                    // r = (p - q).n, linearized over a small rotation w and translation t
+                    const Eigen::Vector3d& n = normals.normal[nearest.second];
+                    const double r = (p - target_level[nearest.second].pos).dot(n);
+
+                    Vector6d J;
+                    J.head<3>() = p.cross(n);
+                    J.tail<3>() = n;
+
+                    reduction.JtJ.selfadjointView<Eigen::Upper>().rankUpdate(J);
+                    reduction.Jtr += J * r;
+                    reduction.sq_error += r * r;
+                    ++reduction.count;
+                }
+            },
+                        threads);
+
+            Reduction total;
+            for (const auto& reduction : reductions)
+            {
+                total.JtJ += reduction.JtJ;
+                total.Jtr += reduction.Jtr;
+                total.sq_error += reduction.sq_error;
+                total.count += reduction.count;
+            }
+
+            level.iterations = iter + 1;
+            level.correspondences = total.count;
+            level.rmse = total.count ? std::sqrt(total.sq_error / total.count) : 0.0;
+            if (total.count < 6)
+                break;
+
+            const Matrix6d JtJ = total.JtJ.selfadjointView<Eigen::Upper>();
+            const Vector6d x = JtJ.ldlt().solve(-total.Jtr);
+            if (!x.allFinite())
+                break;
+
+            const double angle = x.head<3>().norm();
+            Eigen::Isometry3d delta = Eigen::Isometry3d::Identity();
+            if (angle > 0)
+                delta.linear() = Eigen::AngleAxisd(angle, x.head<3>() / angle).toRotationMatrix();
+            delta.translation() = x.tail<3>();
+            transform = delta * transform;
+
+            if (angle < params.min_rotation && x.tail<3>().norm() < params.min_translation)
+                break;
+        }
+
+        level.elapsed_ms = Elapsed(level_start);
+        stats.fitness = static_cast<double>(level.correspondences) / source_level.size();
+        stats.levels.push_back(level);
+    }
+
+    stats.elapsed_ms = Elapsed(start);
+    if (report)
+        *report = stats;
+
+    return transform;
+}
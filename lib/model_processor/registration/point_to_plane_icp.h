@@ -0,0 +1,55 @@
+#pragma once
+#include "def/model.h"
+#include <Eigen/Geometry>
+#include <vector>
+
+struct IcpParams
+{
+    // voxel leaf of each level, coarse to fine, 0 runs on the full clouds
+    std::vector<double> voxel_levels = {2.0, 1.0, 0.5};
+    int max_iterations = 30; // per level
+    // correspondences farther than ratio * leaf are rejected
+    double max_distance_ratio = 3.0;
+    // a level stops once an update moves less than this
+    double min_translation = 1e-4;
+    double min_rotation = 1e-5; // radians
+    // neighbors for the target normals
+    int normal_k = 10;
+    // 0 uses every hardware thread
+    int threads = 0;
+};
+
+struct IcpLevelReport
+{
+    double leaf = 0.0;
+    size_t source_count = 0;
+    size_t target_count = 0;
+    int iterations = 0;
+    size_t correspondences = 0; // in the last iteration
+    double rmse = 0.0;          // point to plane, last iteration
+    double elapsed_ms = 0.0;
+};
+
+struct IcpReport
+{
+    std::vector<IcpLevelReport> levels;
+    // correspondences over source points at the finest level
+    double fitness = 0.0;
+    double elapsed_ms = 0.0;
+};
+
+// point to plane icp, target normals from a grid knn, correspondences searched and
+// the normal equations reduced per thread. each level starts from the last one's result
+class PointToPlaneIcp
+{
+public:
+    PointToPlaneIcp(const IcpParams& params = IcpParams());
+
+    // transform moving source onto target
+    Eigen::Isometry3d Align(const Model& source, const Model& target,
+                            const Eigen::Isometry3d& initial = Eigen::Isometry3d::Identity(),
+                            IcpReport* report = nullptr) const;
+
+private:
+    const IcpParams params;
+};
@@ -0,0 +1,158 @@
+#include "point_grid.h"
+#include "concurrent/parallel_for.h"
+#include "def/win_boundary.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+constexpr int key_bits = 21;
+constexpr int key_max = (1 << key_bits) - 1;
+
+} // namespace
+
+PointGrid::PointGrid(const Model& model, double cell_size)
+    : cell_size(cell_size)
+{
+    WinBoundary box;
+    for (const auto& vertex : model)
+        box.Extend(vertex.pos);
+    origin = box.wmin;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double extent = model.empty() ? 0.0 : (box.wmax(i) - box.wmin(i)) / cell_size;
+        dims[i] = std::min<int>(key_max, static_cast<int>(extent) + 1);
+    }
+
+    // cell key per point, then sort so each cell is one range
+    std::vector<std::pair<uint64_t, size_t>> keyed(model.size());
+    ParallelFor(0, model.size(), [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            int x, y, z;
+            CellOf(model[i].pos, x, y, z);
+            keyed[i] = {KeyOf(x, y, z), i};
+        }
+    });
+    std::sort(keyed.begin(), keyed.end());
+
+    points.resize(keyed.size());
+    indices.resize(keyed.size());
+    ParallelFor(0, keyed.size(), [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            indices[i] = keyed[i].second;
+            points[i] = model[keyed[i].second].pos;
+        }
+    });
+
+    for (size_t i = 0; i < keyed.size();)
+    {
+        size_t j = i + 1;
+        while (j < keyed.size() && keyed[j].first == keyed[i].first)
+            ++j;
+        cells[keyed[i].first] = {i, j};
+        i = j;
+    }
+}
+
+uint64_t PointGrid::KeyOf(int x, int y, int z) const
+{
+    return uint64_t(x) | uint64_t(y) << key_bits | uint64_t(z) << (2 * key_bits);
+}
+
+bool PointGrid::CellOf(const Eigen::Vector3d& pos, int& x, int& y, int& z) const
+{
+    const Eigen::Vector3d idx = (pos - origin) / cell_size;
+    x = static_cast<int>(std::floor(idx.x()));
+    y = static_cast<int>(std::floor(idx.y()));
+    z = static_cast<int>(std::floor(idx.z()));
+    const bool inside = x >= 0 && y >= 0 && z >= 0 && x < dims[0] && y < dims[1] && z < dims[2];
+
+    x = std::max(0, std::min(x, dims[0] - 1));
+    y = std::max(0, std::min(y, dims[1] - 1));
+    z = std::max(0, std::min(z, dims[2] - 1));
+    return inside;
+}
+
+template <typename Func>
+void PointGrid::ForEachInRadius(const Eigen::Vector3d& pos, double radius, const Func& func) const
+{
+    const Eigen::Vector3d lo = (pos - origin).array() / cell_size - radius / cell_size;
+    const Eigen::Vector3d hi = (pos - origin).array() / cell_size + radius / cell_size;
+    const int x0 = std::max(0, static_cast<int>(std::floor(lo.x())));
+    const int y0 = std::max(0, static_cast<int>(std::floor(lo.y())));
+    const int z0 = std::max(0, static_cast<int>(std::floor(lo.z())));
+    const int x1 = std::min(dims[0] - 1, static_cast<int>(std::floor(hi.x())));
+    const int y1 = std::min(dims[1] - 1, static_cast<int>(std::floor(hi.y())));
+    const int z1 = std::min(dims[2] - 1, static_cast<int>(std::floor(hi.z())));
+
+    const double radius2 = radius * radius;
+    for (int z = z0; z <= z1; ++z)
+    {
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                auto iter = cells.find(KeyOf(x, y, z));
+                if (iter == cells.end())
+                    continue;
+
+                for (size_t i = iter->second.first; i < iter->second.second; ++i)
+                {
+                    const double dist2 = (points[i] - pos).squaredNorm();
+                    if (dist2 <= radius2)
+                        func(dist2, indices[i]);
+                }
+            }
+        }
+    }
+}
+
+void PointGrid::KNearest(const Eigen::Vector3d& pos, int k, double radius,
+                         std::vector<Neighbor>& res, size_t skip) const
+{
+    res.clear();
+    if (k <= 0)
+        return;
+
+    // max heap of the best k so far
+    ForEachInRadius(pos, radius, [&](double dist2, size_t index) {
+        if (index == skip)
+            return;
+        if (static_cast<int>(res.size()) < k)
+        {
+            res.emplace_back(dist2, index);
+            std::push_heap(res.begin(), res.end());
+        }
+        else if (dist2 < res.front().first)
+        {
+            std::pop_heap(res.begin(), res.end());
+            res.back() = {dist2, index};
+            std::push_heap(res.begin(), res.end());
+        }
+    });
+    std::sort_heap(res.begin(), res.end());
+}
+
+bool PointGrid::Nearest(const Eigen::Vector3d& pos, double radius, Neighbor& res) const
+{
+    res = {radius * radius + 1.0, SIZE_MAX};
+    ForEachInRadius(pos, radius, [&res](double dist2, size_t index) {
+        if (dist2 < res.first)
+            res = {dist2, index};
+    });
+
+    return res.second != SIZE_MAX;
+}
+
+size_t PointGrid::RadiusCount(const Eigen::Vector3d& pos, double radius, size_t skip) const
+{
+    size_t count = 0;
+    ForEachInRadius(pos, radius, [&count, skip](double, size_t index) {
+        count += index != skip;
+    });
+
+    return count;
+}
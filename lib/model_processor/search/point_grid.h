@@ -0,0 +1,43 @@
+#pragma once
+#include "def/model.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// uniform grid over a model, points of a cell are stored contiguously.
+// queries look at the cells overlapping the search radius only
+class PointGrid
+{
+public:
+    using Neighbor = std::pair<double, size_t>; // squared distance, model index
+
+public:
+    PointGrid(const Model& model, double cell_size);
+
+    // k nearest within radius, sorted by distance, skip excludes a model index
+    void KNearest(const Eigen::Vector3d& pos, int k, double radius,
+                  std::vector<Neighbor>& res, size_t skip = SIZE_MAX) const;
+    // nearest within radius, false if none
+    bool Nearest(const Eigen::Vector3d& pos, double radius, Neighbor& res) const;
+    size_t RadiusCount(const Eigen::Vector3d& pos, double radius, size_t skip = SIZE_MAX) const;
+
+    size_t Size() const { return points.size(); }
+    double CellSize() const { return cell_size; }
+
+private:
+    uint64_t KeyOf(int x, int y, int z) const;
+    bool CellOf(const Eigen::Vector3d& pos, int& x, int& y, int& z) const;
+
+    template <typename Func>
+    void ForEachInRadius(const Eigen::Vector3d& pos, double radius, const Func& func) const;
+
+private:
+    const double cell_size;
+    Eigen::Vector3d origin;
+    int dims[3] = {0, 0, 0};
+
+    std::vector<Eigen::Vector3d> points; // sorted by cell
+    std::vector<size_t> indices;         // model index of points[i]
+    std::unordered_map<uint64_t, std::pair<size_t, size_t>> cells;
+};
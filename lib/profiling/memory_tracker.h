@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+
+// live and peak bytes per subsystem, counted by the tracked allocators.
+// the budget doesn't fail allocations, owners of large buffers check OverBudget
+// and downsample or spill instead
+class MemoryTracker
+{
+public:
+    enum Subsystem
+    {
+        MODEL,   // point clouds, TrackedAllocator behind Model
+        OPENCV,  // cv::Mat buffers once TrackedMatAllocator is installed
+        REGIONS, // sfm regions resident in PagedRegionsProvider
+        SUBSYSTEM_COUNT,
+    };
+
+public:
+    static MemoryTracker& Instance()
+    {
+        static MemoryTracker tracker;
+        return tracker;
+    }
+
+    // MEMORY_BUDGET_MB sets the budget, unset or 0 keeps it unlimited
+    static void InitFromEnv()
+    {
+        const char* budget_mb = std::getenv("MEMORY_BUDGET_MB");
+        if (budget_mb)
+            Instance().SetBudget(static_cast<size_t>(std::atof(budget_mb) * 1024 * 1024));
+    }
+
+    static const char* Name(Subsystem subsystem)
+    {
+        static const char* names[] = {"model", "opencv", "regions"};
+        return names[subsystem];
+    }
+
+    void Allocate(Subsystem subsystem, size_t bytes)
+    {
+        UpdatePeak(counters[subsystem], counters[subsystem].live += bytes);
+        UpdatePeak(total, total.live += bytes);
+    }
+
+    void Release(Subsystem subsystem, size_t bytes)
+    {
+        counters[subsystem].live -= bytes;
+        total.live -= bytes;
+    }
+
+    size_t Live(Subsystem subsystem) const { return counters[subsystem].live; }
+    size_t Peak(Subsystem subsystem) const { return counters[subsystem].peak; }
+    size_t TotalLive() const { return total.live; }
+    size_t TotalPeak() const { return total.peak; }
+
+    // peaks restart from the live bytes
+    void ResetPeak()
+    {
+        for (auto& counter : counters)
+            counter.peak = counter.live.load();
+        total.peak = total.live.load();
+    }
+
+    // 0 is unlimited
+    void SetBudget(size_t bytes) { budget = bytes; }
+    size_t Budget() const { return budget; }
+    bool OverBudget() const { return budget && TotalLive() > budget; }
+    // bytes left under the budget, SIZE_MAX when unlimited
+    size_t Headroom() const
+    {
+        const size_t live = TotalLive();
+        if (!budget)
+            return SIZE_MAX;
+        return live < budget ? budget - live : 0;
+    }
+
+    void Print(std::ostream& os) const
+    {
+        os << "memory (live / peak MiB):";
+        for (int i = 0; i < SUBSYSTEM_COUNT; ++i)
+        {
+            const auto subsystem = static_cast<Subsystem>(i);
+            os << " " << Name(subsystem) << " " << Mib(Live(subsystem)) << " / " << Mib(Peak(subsystem)) << ",";
+        }
+        os << " total " << Mib(TotalLive()) << " / " << Mib(TotalPeak());
+        if (budget)
+            os << ", budget " << Mib(budget);
+        os << "\n";
+    }
+
+private:
+    struct Counter
+    {
+        std::atomic<size_t> live{0};
+        std::atomic<size_t> peak{0};
+    };
+
+    MemoryTracker() = default;
+
+    static void UpdatePeak(Counter& counter, size_t live)
+    {
+        size_t peak = counter.peak.load(std::memory_order_relaxed);
+        while (live > peak && !counter.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    static double Mib(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+private:
+    Counter counters[SUBSYSTEM_COUNT];
+    Counter total;
+    std::atomic<size_t> budget{0};
+};
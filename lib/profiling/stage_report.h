@@ -0,0 +1,137 @@
+#pragma once
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// wall time, process cpu time and peak rss of named stages, written as json.
+// cpu time covers every thread, cpu_s / wall_s is the parallelism a stage got
+class StageReport
+{
+public:
+    struct Stage
+    {
+        std::string name;
+        double wall_s = 0.0;
+        double cpu_s = 0.0;
+        long peak_rss_kb = 0;     // process peak at the end of the stage
+        long rss_growth_kb = 0;   // how much the stage raised the peak
+        std::map<std::string, double> counts;
+    };
+
+    // measures from construction to destruction, counts attach to the stage
+    class Scope
+    {
+    public:
+        Scope(StageReport& report, const std::string& name)
+            : report(report)
+            , wall_start(std::chrono::steady_clock::now())
+            , cpu_start(CpuSeconds())
+            , rss_start(PeakRssKb())
+        {
+            stage.name = name;
+        }
+
+        ~Scope()
+        {
+            stage.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+            stage.cpu_s = CpuSeconds() - cpu_start;
+            stage.peak_rss_kb = PeakRssKb();
+            stage.rss_growth_kb = stage.peak_rss_kb - rss_start;
+            report.stages.push_back(stage);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void Count(const std::string& key, double value) { stage.counts[key] = value; }
+
+    private:
+        StageReport& report;
+        Stage stage;
+        const std::chrono::steady_clock::time_point wall_start;
+        const double cpu_start;
+        const long rss_start;
+    };
+
+public:
+    void SetInfo(const std::string& key, const std::string& value) { info[key] = value; }
+    void SetInfo(const std::string& key, double value) { numbers[key] = value; }
+
+    const std::vector<Stage>& Stages() const { return stages; }
+
+    static double CpuSeconds()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+    }
+
+    // linux reports ru_maxrss in kilobytes
+    static long PeakRssKb()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    std::string ToJson() const
+    {
+        std::ostringstream os;
+        os.precision(15);
+        os << "{\n";
+        for (const auto& item : info)
+            os << "  " << Quote(item.first) << ": " << Quote(item.second) << ",\n";
+        for (const auto& item : numbers)
+            os << "  " << Quote(item.first) << ": " << item.second << ",\n";
+
+        os << "  \"stages\": [";
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            const Stage& stage = stages[i];
+            os << (i ? ",\n" : "\n")
+               << "    {\"name\": " << Quote(stage.name)
+               << ", \"wall_s\": " << stage.wall_s
+               << ", \"cpu_s\": " << stage.cpu_s
+               << ", \"peak_rss_kb\": " << stage.peak_rss_kb
+               << ", \"rss_growth_kb\": " << stage.rss_growth_kb
+               << ", \"counts\": {";
+            size_t c = 0;
+            for (const auto& count : stage.counts)
+                os << (c++ ? ", " : "") << Quote(count.first) << ": " << count.second;
+            os << "}}";
+        }
+        os << "\n  ]\n}\n";
+
+        return os.str();
+    }
+
+    bool WriteJson(const std::string& path) const
+    {
+        std::ofstream file(path);
+        file << ToJson();
+        return file.good();
+    }
+
+private:
+    static std::string Quote(const std::string& str)
+    {
+        std::string res = "\"";
+        for (const char c : str)
+        {
+            if (c == '"' || c == '\\')
+                res += '\\';
+            res += c;
+        }
+        return res + "\"";
+    }
+
+private:
+    std::map<std::string, std::string> info;
+    std::map<std::string, double> numbers;
+    std::vector<Stage> stages;
+};
@@ -0,0 +1,222 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// TRACE_SCOPE("name") records the enclosing scope as a chrome trace event,
+// names are kept by pointer, use string literals. building with TRACE_DISABLED removes every zone.
+// events go to a ring buffer per thread, only the owning thread writes it.
+// buffers of finished unnamed threads are handed to the next new thread, so the
+// short lived ParallelFor workers share a few lanes instead of one buffer each
+#ifndef TRACE_DISABLED
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::Instance().SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+class Tracer
+{
+public:
+    struct Event
+    {
+        const char* name;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    // the oldest events are overwritten once a thread records more than capacity
+    struct ThreadBuffer
+    {
+        static constexpr size_t capacity = size_t(1) << 16;
+
+        int tid = 0;
+        std::string name;
+        std::atomic<uint64_t> head{0};
+        std::vector<Event> events = std::vector<Event>(capacity);
+    };
+
+public:
+    static Tracer& Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void Enable(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+    bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // microseconds since the tracer was created
+    int64_t NowUs() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - epoch)
+            .count();
+    }
+
+    void Record(const char* name, int64_t start_us, int64_t end_us)
+    {
+        ThreadBuffer& buffer = LocalBuffer();
+        const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head % ThreadBuffer::capacity] = {name, start_us, end_us - start_us};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void SetThreadName(const std::string& name)
+    {
+        if (!Enabled())
+            return;
+
+        // a recycled lane holds other threads' events, a named thread gets its own
+        LocalSlot& slot = LocalSlotOf();
+        if (slot.buffer)
+            Release(std::move(slot.buffer));
+        slot.buffer = Acquire(true);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        slot.buffer->name = name;
+    }
+
+    // chrome://tracing and perfetto read this, events still being written may be skipped
+    bool WriteChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path);
+        file << "{\"traceEvents\": [";
+
+        bool first = true;
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& buffer : buffers)
+        {
+            if (!buffer->name.empty())
+            {
+                file << (first ? "\n" : ",\n")
+                     << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                     << ", \"args\": {\"name\": \"" << buffer->name << "\"}}";
+                first = false;
+            }
+
+            const uint64_t head = buffer->head.load(std::memory_order_acquire);
+            const uint64_t begin = head > ThreadBuffer::capacity ? head - ThreadBuffer::capacity : 0;
+            for (uint64_t i = begin; i < head; ++i)
+            {
+                const Event& event = buffer->events[i % ThreadBuffer::capacity];
+                file << (first ? "\n" : ",\n")
+                     << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid
+                     << ", \"ts\": " << event.start_us << ", \"dur\": " << event.duration_us << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+
+        return file.good();
+    }
+
+    // tracing is on when TRACE_FILE is set, the trace is written there when the program exits
+    static void InitFromEnv()
+    {
+        const char* path = std::getenv("TRACE_FILE");
+        if (!path || !*path)
+            return;
+
+        Instance().Enable(true);
+        std::atexit([]() { Instance().WriteChromeTrace(std::getenv("TRACE_FILE")); });
+    }
+
+private:
+    Tracer()
+        : epoch(std::chrono::steady_clock::now())
+    {
+    }
+
+    // hands the buffer back when its thread exits
+    struct LocalSlot
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        ~LocalSlot()
+        {
+            if (buffer)
+                Instance().Release(std::move(buffer));
+        }
+    };
+
+    static LocalSlot& LocalSlotOf()
+    {
+        thread_local LocalSlot slot;
+        return slot;
+    }
+
+    ThreadBuffer& LocalBuffer()
+    {
+        LocalSlot& slot = LocalSlotOf();
+        if (!slot.buffer)
+            slot.buffer = Acquire(false);
+        return *slot.buffer;
+    }
+
+    // buffers stay in the registry after their thread exits, so their events are still exported
+    std::shared_ptr<ThreadBuffer> Acquire(bool fresh)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!fresh && !free_buffers.empty())
+        {
+            auto buffer = std::move(free_buffers.back());
+            free_buffers.pop_back();
+            return buffer;
+        }
+
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->tid = static_cast<int>(buffers.size()) + 1;
+        buffers.push_back(buffer);
+        return buffer;
+    }
+
+    // a named lane isn't reused, other threads' events would show up under its name
+    void Release(std::shared_ptr<ThreadBuffer> buffer)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (buffer->name.empty())
+            free_buffers.push_back(std::move(buffer));
+    }
+
+private:
+    const std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> enabled{false};
+
+    mutable std::mutex mtx;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<std::shared_ptr<ThreadBuffer>> free_buffers;
+};
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char* name)
+        : name(Tracer::Instance().Enabled() ? name : nullptr)
+        , start_us(this->name ? Tracer::Instance().NowUs() : 0)
+    {
+    }
+
+    ~TraceZone()
+    {
+        if (name)
+            Tracer::Instance().Record(name, start_us, Tracer::Instance().NowUs());
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* const name;
+    const int64_t start_us;
+};
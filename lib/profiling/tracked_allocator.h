@@ -0,0 +1,49 @@
+#pragma once
+#include "profiling/memory_tracker.h"
+#include <memory>
+
+// std::allocator that counts its bytes under subsystem in MemoryTracker
+template <typename T, MemoryTracker::Subsystem subsystem>
+class TrackedAllocator
+{
+public:
+    using value_type = T;
+
+    // the subsystem parameter keeps allocator_traits from rebinding on its own
+    template <typename U>
+    struct rebind
+    {
+        using other = TrackedAllocator<U, subsystem>;
+    };
+
+    TrackedAllocator() = default;
+    template <typename U>
+    TrackedAllocator(const TrackedAllocator<U, subsystem>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        T* p = std::allocator<T>().allocate(n);
+        MemoryTracker::Instance().Allocate(subsystem, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        MemoryTracker::Instance().Release(subsystem, n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template <typename T, typename U, MemoryTracker::Subsystem subsystem>
+bool operator==(const TrackedAllocator<T, subsystem>&, const TrackedAllocator<U, subsystem>&)
+{
+    return true;
+}
+
+template <typename T, typename U, MemoryTracker::Subsystem subsystem>
+bool operator!=(const TrackedAllocator<T, subsystem>&, const TrackedAllocator<U, subsystem>&)
+{
+    return false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "profiling/memory_tracker.h"
+#include <opencv2/core/mat.hpp>
+
+// counts every cv::Mat buffer under MemoryTracker::OPENCV once installed,
+// the memory itself still comes from opencv's standard allocator
+class TrackedMatAllocator : public cv::MatAllocator
+{
+public:
+#if CV_VERSION_MAJOR >= 4
+    using AccessFlags = cv::AccessFlag;
+#else
+    using AccessFlags = int;
+#endif
+
+    // mats created before keep their allocator and stay uncounted
+    static void Install()
+    {
+        static TrackedMatAllocator allocator;
+        cv::Mat::setDefaultAllocator(&allocator);
+    }
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           AccessFlags flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        cv::UMatData* u = Std()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+        if (!u)
+            return u;
+
+        // Mat releases through currAllocator, so deallocate comes back here
+        u->currAllocator = this;
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+            MemoryTracker::Instance().Allocate(MemoryTracker::OPENCV, u->size);
+        return u;
+    }
+
+    bool allocate(cv::UMatData* u, AccessFlags flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        return Std()->allocate(u, flags, usage_flags);
+    }
+
+    void deallocate(cv::UMatData* u) const override
+    {
+        if (!u)
+            return;
+
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+            MemoryTracker::Instance().Release(MemoryTracker::OPENCV, u->size);
+        u->currAllocator = Std();
+        Std()->deallocate(u);
+    }
+
+private:
+    static const cv::MatAllocator* Std() { return cv::Mat::getStdAllocator(); }
+};
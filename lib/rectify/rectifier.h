@@ -1,4 +1,5 @@
 #pragma once
+#include "profiling/trace.h"
 #include <opencv2/ml/ml.hpp>
 #include <opencv2/opencv.hpp>
 #include <string>
@@ -22,6 +23,7 @@ public:
 
     cv::Mat rectify(const cv::Mat& img, const ImgIdx& id = INVAILD) const
     {
+        TRACE_SCOPE("Rectifier::rectify");
         cv::Mat res;
         switch (id)
         {
@@ -38,6 +40,28 @@ public:
         return res;
     }
 
+    // only the pixels of roi in the rectified image
+    cv::Mat rectify(const cv::Mat& img, const ImgIdx& id, const cv::Rect& roi) const
+    {
+        TRACE_SCOPE("Rectifier::rectify roi");
+        cv::Mat res;
+        switch (id)
+        {
+        case ImgIdx::LEFT:
+            cv::remap(img, res, left_map1(roi), left_map2(roi), cv::INTER_LINEAR);
+            break;
+        case ImgIdx::RIGHT:
+            cv::remap(img, res, right_map1(roi), right_map2(roi), cv::INTER_LINEAR);
+            break;
+        default:
+            return img(roi);
+        }
+
+        return res;
+    }
+
+    cv::Size image_size() const { return left_map1.size(); }
+
 private:
     void init_rectify_para(const std::string& map_folder)
     {
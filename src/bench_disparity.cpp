@@ -0,0 +1,207 @@
+#include "model_generator/disparity/census_sgm.h"
+#include "model_generator/disparity/sgbm_solver.h"
+#include "concurrent/parallel_for.h"
+#include "profiling/tracked_mat_allocator.h"
+#include "profiling/trace.h"
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+
+template <typename Func>
+double TimeMs(const Func& func, int repeat)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; ++i)
+        func();
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count() /
+           repeat;
+}
+
+// mean abs difference over pixels valid in both maps, near seams and overall
+void CompareDisparity(const cv::Mat& base, const cv::Mat& test, int strips,
+                      double& seam_err, double& total_err)
+{
+    const int strip_rows = (base.rows + strips - 1) / strips;
+    const int seam_band = 8;
+
+    double seam_sum = 0.0, total_sum = 0.0;
+    size_t seam_cnt = 0, total_cnt = 0;
+    for (int v = 0; v < base.rows; ++v)
+    {
+        const int dy = v % strip_rows;
+        const bool near_seam = v >= strip_rows && (dy < seam_band || strip_rows - dy <= seam_band);
+        for (int u = 0; u < base.cols; ++u)
+        {
+            const float b = base.ptr<float>(v)[u];
+            const float t = test.ptr<float>(v)[u];
+            if (b < 0 || t < 0)
+                continue;
+
+            const double err = std::abs(b - t);
+            total_sum += err;
+            ++total_cnt;
+            if (near_seam)
+            {
+                seam_sum += err;
+                ++seam_cnt;
+            }
+        }
+    }
+
+    seam_err = seam_cnt ? seam_sum / seam_cnt : 0.0;
+    total_err = total_cnt ? total_sum / total_cnt : 0.0;
+}
+
+// textured left image and a right image warped by a slanted plane with a raised box,
+// gt is the left image disparity, -1 where occluded
+void SyntheticPair(const cv::Size& size, cv::Mat& left, cv::Mat& right, cv::Mat& gt)
+{
+    cv::RNG rng(2020);
+    left.create(size, CV_8UC1);
+    rng.fill(left, cv::RNG::UNIFORM, 0, 255);
+    cv::GaussianBlur(left, left, cv::Size(3, 3), 0.8);
+
+    const cv::Rect box(size.width / 3, size.height / 3, size.width / 3, size.height / 3);
+    right.create(size, CV_8UC1);
+    gt = cv::Mat(size, CV_32F, cv::Scalar(-1));
+    for (int v = 0; v < size.height; ++v)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            float d = 16.0f + 20.0f * x / size.width;
+            if (box.contains(cv::Point(x, v)))
+                d += 16.0f;
+
+            const float u = x + d;
+            const int u0 = static_cast<int>(u);
+            const float a = u - u0;
+            if (u0 + 1 >= size.width)
+            {
+                right.ptr<uchar>(v)[x] = left.ptr<uchar>(v)[size.width - 1];
+                continue;
+            }
+            right.ptr<uchar>(v)[x] = cv::saturate_cast<uchar>(
+                (1 - a) * left.ptr<uchar>(v)[u0] + a * left.ptr<uchar>(v)[u0 + 1]);
+
+            // nearer surface wins where several right pixels land
+            float& g = gt.ptr<float>(v)[cvRound(u)];
+            g = std::max(g, d);
+        }
+    }
+}
+
+// bad pixel rate (> 1px), mean abs error and density against gt
+void Accuracy(const cv::Mat& disp, const cv::Mat& gt, double& bad, double& mae, double& density)
+{
+    size_t gt_cnt = 0, valid_cnt = 0, bad_cnt = 0;
+    double err_sum = 0.0;
+    for (int v = 0; v < gt.rows; ++v)
+    {
+        for (int u = 0; u < gt.cols; ++u)
+        {
+            const float g = gt.ptr<float>(v)[u];
+            if (g < 0)
+                continue;
+            ++gt_cnt;
+
+            const float d = disp.ptr<float>(v)[u];
+            if (d < 0)
+                continue;
+            ++valid_cnt;
+
+            const double err = std::abs(d - g);
+            err_sum += err;
+            bad_cnt += err > 1.0;
+        }
+    }
+
+    bad = valid_cnt ? 100.0 * bad_cnt / valid_cnt : 0.0;
+    mae = valid_cnt ? err_sum / valid_cnt : 0.0;
+    density = gt_cnt ? 100.0 * valid_cnt / gt_cnt : 0.0;
+}
+
+} // namespace
+
+// usage: bench_disparity [left_image right_image]
+int main(int argc, char** argv)
+{
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
+    TrackedMatAllocator::Install();
+    auto sgbm_solver = SgbmSolver("/home/ospacer/Documents/resource",
+                                  "/map",
+                                  "/images/heart_model2/left",
+                                  "/images/heart_model2/right");
+
+    StereoFrame frame;
+    const std::string left_name = argc > 2 ? argv[1] : "left_1.png";
+    const std::string right_name = argc > 2 ? argv[2] : "right_1.png";
+    if (!sgbm_solver.Load(left_name, right_name, frame))
+    {
+        std::cout << "load stereo pair fail\n";
+        return EXIT_FAILURE;
+    }
+    sgbm_solver.Rectify(frame);
+
+    constexpr int repeat = 3;
+
+    // strip-parallel sgbm
+    {
+        StereoFrame base = frame;
+        sgbm_solver.SetStripCount(1);
+        const double base_ms = TimeMs([&]() { sgbm_solver.ComputeDisparity(base); }, repeat);
+        std::cout << "--- strip sgbm, " << frame.left.cols << "x" << frame.left.rows
+                  << ", margin " << sgbm_solver.StripMargin() << " rows ---\n"
+                  << "strips\tms\tspeedup\tseam_err\ttotal_err\n"
+                  << 1 << "\t" << base_ms << "\t" << 1.0 << "\t" << 0.0 << "\t" << 0.0 << "\n";
+
+        for (int strips = 2; strips <= 2 * ThreadCount(); strips *= 2)
+        {
+            StereoFrame test = frame;
+            sgbm_solver.SetStripCount(strips);
+            const double ms = TimeMs([&]() { sgbm_solver.ComputeDisparity(test); }, repeat);
+
+            double seam_err, total_err;
+            CompareDisparity(base.disp, test.disp, strips, seam_err, total_err);
+            std::cout << strips << "\t" << ms << "\t" << base_ms / ms << "\t"
+                      << seam_err << "\t" << total_err << "\n";
+        }
+        sgbm_solver.SetStripCount(1);
+    }
+
+    // opencv sgbm vs census sgm on a synthetic 1080p pair
+    {
+        StereoFrame synthetic;
+        cv::Mat gt;
+        SyntheticPair(cv::Size(1920, 1080), synthetic.left, synthetic.right, gt);
+
+        std::cout << "--- stereo backends, synthetic 1920x1080, "
+                  << sgbm_solver.GetParams().num_disparities << " disparities, avx2 "
+                  << (CensusSgm::UseAvx2() ? "on" : "off") << " ---\n"
+                  << "backend\tms\tbad(%)\tmae\tdensity(%)\n";
+
+        const char* names[] = {"opencv_sgbm", "census_sgm"};
+        for (auto backend : {SgbmParams::OPENCV_SGBM, SgbmParams::CENSUS_SGM})
+        {
+            SgbmParams params = sgbm_solver.GetParams();
+            params.backend = backend;
+            sgbm_solver.SetParams(params);
+
+            const double ms = TimeMs([&]() { sgbm_solver.ComputeDisparity(synthetic); }, repeat);
+            double bad, mae, density;
+            Accuracy(synthetic.disp, gt, bad, mae, density);
+            std::cout << names[backend] << "\t" << ms << "\t" << bad << "\t"
+                      << mae << "\t" << density << "\n";
+        }
+
+        SgbmParams params = sgbm_solver.GetParams();
+        params.backend = SgbmParams::OPENCV_SGBM;
+        sgbm_solver.SetParams(params);
+    }
+
+    return 0;
+}
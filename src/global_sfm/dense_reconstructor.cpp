@@ -0,0 +1,126 @@
+#include "dense_reconstructor.h"
+#include "concurrent/parallel_for.h"
+#include "model_processor/filter/budget_filter.h"
+#include "model_processor/filter/voxel_filter.h"
+#include "model_processor/fusion/tsdf_volume.h"
+#include "profiling/trace.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <opencv2/imgproc.hpp>
+
+namespace
+{
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+DenseReconstructor::DenseReconstructor(const SgbmSolver& solver, const DenseParams& params)
+    : solver(solver)
+    , params(params)
+{
+}
+
+Model DenseReconstructor::Reproject(const cv::Mat& depth, const cv::Mat& color, const Eigen::Isometry3d& pose) const
+{
+    const PinholeCamera camera = solver.Camera();
+
+    Model model;
+    for (int v = 0; v < depth.rows; ++v)
+    {
+        const float* depth_row = depth.ptr<float>(v);
+        const cv::Vec3b* color_row = color.ptr<cv::Vec3b>(v);
+        for (int u = 0; u < depth.cols; ++u)
+        {
+            if (depth_row[u] <= 0)
+                continue;
+
+            const cv::Vec3b& bgr = color_row[u];
+            model.push_back({pose * camera.BackProject(u, v, depth_row[u]), {bgr[2], bgr[1], bgr[0]}});
+        }
+    }
+
+    return model;
+}
+
+Model DenseReconstructor::Reconstruct(const std::vector<PosedStereoPair>& pairs, WinBoundary& bound,
+                                      DenseReport* report) const
+{
+    TRACE_SCOPE("DenseReconstructor::Reconstruct");
+    auto start = std::chrono::steady_clock::now();
+    DenseReport stats;
+    stats.pairs.resize(pairs.size());
+
+    const double min_depth = params.min_depth > 0 ? params.min_depth : solver.MetricMinDepth();
+    const double max_depth = params.max_depth > 0 ? params.max_depth : solver.MetricMaxDepth();
+    TsdfVolume volume(params.voxel_size, params.truncation);
+    volume.SetDepthRange(min_depth, max_depth);
+    Model merged;
+
+    // pairs are solved concurrently, fusion into the shared volume or cloud is serialized
+    std::mutex fuse_mtx;
+    std::atomic<size_t> next_pair{0};
+    const int workers = std::max(1, std::min(params.workers > 0 ? params.workers : ThreadCount(),
+                                             static_cast<int>(pairs.size())));
+    auto solve = [&](size_t, size_t, int) {
+        for (size_t i = next_pair++; i < pairs.size(); i = next_pair++)
+        {
+            TRACE_SCOPE("dense pair");
+            const PosedStereoPair& pair = pairs[i];
+            DensePairReport& pair_report = stats.pairs[i];
+            pair_report.name = pair.name;
+
+            auto pair_start = std::chrono::steady_clock::now();
+            StereoFrame frame;
+            frame.left_color = pair.left;
+            cv::cvtColor(pair.left, frame.left, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(pair.right, frame.right, cv::COLOR_BGR2GRAY);
+            solver.ComputeDisparity(frame);
+            const cv::Mat depth = solver.MetricDepth(frame.disp, min_depth, max_depth);
+            pair_report.disparity_ms = ElapsedMs(pair_start);
+
+            TRACE_SCOPE("dense fuse");
+            auto fuse_start = std::chrono::steady_clock::now();
+            const Eigen::Isometry3d pose = pair.Pose();
+            if (params.fusion == DenseParams::TSDF)
+            {
+                pair_report.points = cv::countNonZero(depth);
+
+                std::lock_guard<std::mutex> lock(fuse_mtx);
+                volume.Integrate(depth, frame.left_color, solver.Camera(), pose);
+            }
+            else
+            {
+                // thinned per pair first, the final grid only resolves the overlaps
+                WinBoundary pair_bound;
+                Model model = VoxelFilter(params.voxel_size).Filter(Reproject(depth, frame.left_color, pose), pair_bound);
+                pair_report.points = model.size();
+
+                std::lock_guard<std::mutex> lock(fuse_mtx);
+                merged.insert(merged.end(), model.begin(), model.end());
+            }
+            pair_report.fuse_ms = ElapsedMs(fuse_start);
+
+            std::lock_guard<std::mutex> lock(fuse_mtx);
+            std::cout << pair.name << ": " << pair_report.points << " pts, disparity "
+                      << pair_report.disparity_ms << " ms, fuse " << pair_report.fuse_ms << " ms\n";
+        }
+    };
+    ParallelFor(0, workers, solve, workers);
+
+    Model model = params.fusion == DenseParams::TSDF ? volume.ExtractCloud(bound)
+                                                     : BudgetFilter(params.voxel_size).Filter(merged, bound);
+
+    stats.points = model.size();
+    stats.elapsed_s = ElapsedMs(start) / 1000.0;
+    stats.pairs_per_s = stats.elapsed_s > 0 ? pairs.size() / stats.elapsed_s : 0.0;
+    if (report)
+        *report = stats;
+
+    return model;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include "model_generator/disparity/sgbm_solver.h"
+#include "posed_stereo_pair.h"
+#include <string>
+#include <vector>
+
+struct DenseParams
+{
+    enum Fusion
+    {
+        VOXEL, // merge the reprojected clouds through a voxel grid
+        TSDF,  // integrate the depth maps, one vertex per surface crossing
+    };
+
+    Fusion fusion = TSDF;
+    double voxel_size = 0.2;
+    double truncation = 0.6; // tsdf only
+    // metric depth kept from the disparity, in baseline units. 0 takes the solver's
+    // working range, far tiny disparities would each allocate their own tsdf blocks
+    double min_depth = 0.0;
+    double max_depth = 0.0;
+    // pairs solved at once, 0 uses every hardware thread
+    int workers = 0;
+};
+
+struct DensePairReport
+{
+    std::string name;
+    size_t points = 0;
+    double disparity_ms = 0.0;
+    double fuse_ms = 0.0;
+};
+
+struct DenseReport
+{
+    std::vector<DensePairReport> pairs;
+    size_t points = 0;
+    double elapsed_s = 0.0;
+    double pairs_per_s = 0.0;
+};
+
+// dense cloud of posed rectified pairs, disparities are solved in parallel and the
+// metric depth of every pair is fused in the common frame of the poses
+class DenseReconstructor
+{
+public:
+    DenseReconstructor(const SgbmSolver& solver, const DenseParams& params = DenseParams());
+
+    Model Reconstruct(const std::vector<PosedStereoPair>& pairs, WinBoundary& bound,
+                      DenseReport* report = nullptr) const;
+
+private:
+    Model Reproject(const cv::Mat& depth, const cv::Mat& color, const Eigen::Isometry3d& pose) const;
+
+private:
+    const SgbmSolver& solver;
+    const DenseParams params;
+};
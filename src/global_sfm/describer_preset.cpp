@@ -0,0 +1,136 @@
+#include "describer_preset.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <openMVG/features/akaze/image_describer_akaze.hpp>
+#include <openMVG/matching/matcher_type.hpp>
+#include <openMVG/matching_image_collection/Cascade_Hashing_Matcher_Regions.hpp>
+#include <openMVG/matching_image_collection/Matcher_Regions.hpp>
+
+#include <nonFree/sift/SIFT_describer_io.hpp>
+
+using namespace openMVG;
+using namespace openMVG::features;
+using namespace openMVG::matching;
+using namespace openMVG::matching_image_collection;
+
+namespace
+{
+constexpr size_t max_capped_features = 2000;
+constexpr float match_ratio = 0.8f;
+} // namespace
+
+const std::vector<DescriberPreset::Type>& DescriberPreset::All()
+{
+    static const std::vector<Type> all = {SIFT, SIFT_HALF, SIFT_CAPPED, AKAZE_MLDB};
+    return all;
+}
+
+bool DescriberPreset::Parse(const std::string& name, DescriberPreset& preset)
+{
+    for (const auto type : All())
+    {
+        if (DescriberPreset(type).Name() == name)
+        {
+            preset = DescriberPreset(type);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string DescriberPreset::Name() const
+{
+    switch (type)
+    {
+    case SIFT_HALF:
+        return "sift_half";
+    case SIFT_CAPPED:
+        return "sift_capped";
+    case AKAZE_MLDB:
+        return "akaze_mldb";
+    default:
+        return "sift";
+    }
+}
+
+std::unique_ptr<Image_describer> DescriberPreset::CreateDescriber() const
+{
+    switch (type)
+    {
+    case SIFT_HALF:
+    {
+        SIFT_Image_describer::Params params;
+        params.first_octave_ = 1;
+        return std::make_unique<SIFT_Image_describer>(params);
+    }
+    case AKAZE_MLDB:
+        return AKAZE_Image_describer::create(AKAZE_Image_describer::Params(AKAZE::Params(), features::AKAZE_MLDB));
+    default:
+        return std::make_unique<SIFT_Image_describer>();
+    }
+}
+
+std::unique_ptr<Regions> DescriberPreset::CreateRegionsType() const
+{
+    if (type == AKAZE_MLDB)
+        return std::make_unique<AKAZE_Binary_Regions>();
+
+    return std::make_unique<SIFT_Regions>();
+}
+
+std::unique_ptr<Matcher> DescriberPreset::CreateMatcher() const
+{
+    // cascade hashing only handles scalar descriptors, hamming distance goes through popcount
+    if (type == AKAZE_MLDB)
+        return std::make_unique<Matcher_Regions>(match_ratio, BRUTE_FORCE_HAMMING);
+
+    return std::make_unique<Cascade_Hashing_Matcher_Regions>(match_ratio);
+}
+
+size_t DescriberPreset::BytesPerPixel() const
+{
+    switch (type)
+    {
+    case SIFT_HALF:
+        return 10;
+    case AKAZE_MLDB:
+        // several float images per nonlinear scale level
+        return 160;
+    default:
+        return 32;
+    }
+}
+
+void DescriberPreset::Limit(Regions& regions) const
+{
+    if (type != SIFT_CAPPED || regions.RegionCount() <= max_capped_features)
+        return;
+
+    // larger scale keypoints survive more viewpoint change
+    auto& sift = dynamic_cast<SIFT_Regions&>(regions);
+    auto& feats = sift.Features();
+    auto& descs = sift.Descriptors();
+
+    std::vector<size_t> order(feats.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::partial_sort(order.begin(), order.begin() + max_capped_features, order.end(),
+                      [&feats](size_t a, size_t b) { return feats[a].scale() > feats[b].scale(); });
+    order.resize(max_capped_features);
+    std::sort(order.begin(), order.end());
+
+    SIFT_Regions::FeatsT kept_feats;
+    SIFT_Regions::DescsT kept_descs;
+    kept_feats.reserve(order.size());
+    kept_descs.reserve(order.size());
+    for (const auto i : order)
+    {
+        kept_feats.push_back(feats[i]);
+        kept_descs.push_back(descs[i]);
+    }
+
+    feats.swap(kept_feats);
+    descs.swap(kept_descs);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openMVG
+{
+namespace features
+{
+class Image_describer;
+class Regions;
+} // namespace features
+namespace matching_image_collection
+{
+class Matcher;
+} // namespace matching_image_collection
+} // namespace openMVG
+
+// feature extraction and matching settings, from robust to fast
+class DescriberPreset
+{
+public:
+    enum Type
+    {
+        SIFT,        // full resolution sift, cascade hashing
+        SIFT_HALF,   // sift starting one octave up, a quarter of the pixels
+        SIFT_CAPPED, // full resolution sift keeping the largest scale keypoints
+        AKAZE_MLDB   // binary akaze descriptors, brute force hamming
+    };
+
+    DescriberPreset(Type type = SIFT)
+        : type(type)
+    {
+    }
+
+    static const std::vector<Type>& All();
+    static bool Parse(const std::string& name, DescriberPreset& preset);
+
+    Type GetType() const { return type; }
+    std::string Name() const;
+
+    std::unique_ptr<openMVG::features::Image_describer> CreateDescriber() const;
+    std::unique_ptr<openMVG::features::Regions> CreateRegionsType() const;
+    std::unique_ptr<openMVG::matching_image_collection::Matcher> CreateMatcher() const;
+
+    // rough peak memory of the describer per input pixel
+    size_t BytesPerPixel() const;
+    // drops keypoints over the preset's cap
+    void Limit(openMVG::features::Regions& regions) const;
+
+private:
+    Type type;
+};
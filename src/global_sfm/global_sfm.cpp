@@ -1,10 +1,15 @@
 #include "global_sfm.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -28,20 +33,29 @@
 #include <openMVG/sfm/pipelines/sfm_matches_provider.hpp>
 #include <openMVG/sfm/pipelines/sfm_regions_provider.hpp>
 
-#include <openMVG/matching_image_collection/Cascade_Hashing_Matcher_Regions.hpp>
 #include <openMVG/matching_image_collection/F_ACRobust.hpp>
 #include <openMVG/matching_image_collection/GeometricFilter.hpp>
-#include <openMVG/matching_image_collection/Matcher_Regions.hpp>
+#include <openMVG/matching_image_collection/Matcher.hpp>
 #include <openMVG/matching_image_collection/Pair_Builder.hpp>
 
-#include <nonFree/sift/SIFT_describer_io.hpp>
+#include <openMVG/features/image_describer.hpp>
 #include <third_party/progress/progress_display.hpp>
 #include <third_party/stlplus3/filesystemSimplified/file_system.hpp>
 
 #define USE_STEREO 1
 // #define USE_IPHONE7P 1
+#include "concurrent/byte_budget.h"
+#include "concurrent/parallel_for.h"
 #include "def/cam_para.h"
+#include "describer_preset.h"
 #include "model_generator/ply/SfMPlyHelper.hpp"
+#include "paged_regions_provider.h"
+#include "profiling/memory_tracker.h"
+#include "profiling/stage_report.h"
+#include "profiling/trace.h"
+#include "rig_pair_builder.h"
+#include "sfm_cache.h"
+#include <opencv2/opencv.hpp>
 
 #ifdef USE_STEREO
 #include "rectify/rectifier.h"
@@ -65,41 +79,90 @@ namespace
 
 const std::string sfm_data_file = "sfm_data.json";
 const std::string color_ply_name = "color.ply";
+const std::string real_ply_name = "real.ply";
+const std::string report_json_name = "sfm_report.json";
 const std::string left_prefix = "left_";
 const std::string right_prefix = "right_";
 const std::string rect_prefix = "rect_";
 const std::string ref_id = "1";
+const std::string cache_folder = "cache";
 
-struct My_Regions_Provider : Regions_Provider
+// part of the cache keys next to the describer preset name, bump when a stage changes
+const std::string putative_tag = "ratio_0.8";
+const std::string geometric_tag = "fmatrix_ac_4.0_2048_0.6";
+const std::string rig_tag = "_rig_1.5";
+
+// rectified rig pairs: row difference allowed for a match, and the fewest matches kept for a pair
+constexpr double rig_epipolar_tolerance = 1.5;
+constexpr size_t rig_min_matches = 30;
+
+using ImageMap = std::map<std::string, cv::Mat>;
+
+void ToGrayImage(const cv::Mat& img, Image<unsigned char>& gray_image)
 {
-public:
-    My_Regions_Provider(std::unique_ptr<Regions>& region_type)
-        : Regions_Provider()
-    {
-        region_type_.reset(region_type->EmptyClone());
-    }
+    cv::Mat gray;
+    cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
 
-    void insert(IndexT id_view, std::shared_ptr<Regions> regions)
-    {
-        cache_[id_view] = regions;
-    }
-};
+    gray_image = Image<unsigned char>(gray.cols, gray.rows);
+    for (int v = 0; v < gray.rows; ++v)
+        std::memcpy(gray_image.data() + static_cast<size_t>(v) * gray.cols, gray.ptr(v), gray.cols);
+}
 
-/// Export camera poses positions as a Vec3 vector
-std::vector<Vec3> GetCameraPositions(const SfM_Data& sfm_data)
+// color of the first observation whose view is in images,
+// ColorizeTracks reads the views from disk when images is empty
+bool ColorizeLandmarks(const SfM_Data& sfm_data, const ImageMap& images,
+                       std::vector<Vec3>& vec_3dPoints, std::vector<Vec3>& vec_tracksColor)
 {
-    std::vector<Vec3> vec_camPosition;
+    if (images.empty())
+        return ColorizeTracks(sfm_data, vec_3dPoints, vec_tracksColor);
 
-    for (const auto& view : sfm_data.GetViews())
+    vec_3dPoints.clear();
+    vec_tracksColor.clear();
+    for (const auto& landmark : sfm_data.GetLandmarks())
     {
-        if (sfm_data.IsPoseAndIntrinsicDefined(view.second.get()))
+        Vec3 color(255, 255, 255);
+        for (const auto& obs : landmark.second.obs)
         {
-            const geometry::Pose3 pose = sfm_data.GetPoseOrDie(view.second.get());
-            vec_camPosition.push_back(pose.center());
+            const View* view = sfm_data.GetViews().at(obs.first).get();
+            auto image = images.find(view->s_Img_path);
+            if (image == images.end())
+                continue;
+
+            const cv::Mat& img = image->second;
+            const int u = static_cast<int>(obs.second.x(0));
+            const int v = static_cast<int>(obs.second.x(1));
+            if (u < 0 || v < 0 || u >= img.cols || v >= img.rows)
+                continue;
+
+            const cv::Vec3b bgr = img.at<cv::Vec3b>(v, u);
+            color = Vec3(bgr[2], bgr[1], bgr[0]);
+            break;
         }
+
+        vec_3dPoints.push_back(landmark.second.X);
+        vec_tracksColor.push_back(color);
     }
 
-    return vec_camPosition;
+    return !vec_3dPoints.empty();
+}
+
+// matches of a rectified left/right pair lie on the same row with non-negative disparity,
+// which replaces robust estimation of a model the rig already fixes
+IndMatches FilterRigMatches(const IndMatches& matches,
+                            const features::PointFeatures& left_feats,
+                            const features::PointFeatures& right_feats,
+                            bool left_first)
+{
+    IndMatches inliers;
+    for (const auto& match : matches)
+    {
+        const auto& left = left_feats[left_first ? match.i_ : match.j_];
+        const auto& right = right_feats[left_first ? match.j_ : match.i_];
+        if (std::abs(left.y() - right.y()) <= rig_epipolar_tolerance && left.x() >= right.x())
+            inliers.push_back(match);
+    }
+
+    return inliers;
 }
 
 // get camera position with given left && right path
@@ -137,6 +200,57 @@ std::vector<Vec3> GetCameraPositionsNew(const SfM_Data& sfm_data, PPP& ppp)
     return vec_camPosition;
 }
 
+// camera centers in green ahead of the landmarks, the same layout exportToPly writes
+Model ToModel(const std::vector<Vec3>& vec_points,
+              const std::vector<Vec3>& vec_colors,
+              const std::vector<Vec3>& vec_camPos,
+              WinBoundary& bound)
+{
+    Model model;
+    model.reserve(vec_points.size() + vec_camPos.size());
+
+    for (const auto& pos : vec_camPos)
+    {
+        model.push_back({pos, {0, 255, 0}});
+        bound.Extend(pos);
+    }
+    for (size_t i = 0; i < vec_points.size(); ++i)
+    {
+        const auto& color = vec_colors[i];
+        model.push_back({vec_points[i], {static_cast<int>(color(0)), static_cast<int>(color(1)), static_cast<int>(color(2))}});
+        bound.Extend(vec_points[i]);
+    }
+
+    return model;
+}
+
+// left camera -> world in the frame AdjustModelPosition moves the model to, the baseline sets the scale
+void CollectStereoPairs(const SfM_Data& sfm_data, const ImageMap& images, const PPP& ppp,
+                        std::vector<PosedStereoPair>& stereo_pairs)
+{
+    const double scale = CameraPara::baseline / ppp.Distance();
+    RigPairBuilder rig(left_prefix, right_prefix, 0, 0);
+    for (const auto& partner : rig.Partners(sfm_data))
+    {
+        const View* left_view = sfm_data.GetViews().at(partner.first).get();
+        const View* right_view = sfm_data.GetViews().at(partner.second).get();
+        auto left_image = images.find(left_view->s_Img_path);
+        auto right_image = images.find(right_view->s_Img_path);
+        if (!sfm_data.IsPoseAndIntrinsicDefined(left_view) ||
+            left_image == images.end() || right_image == images.end())
+            continue;
+
+        const geometry::Pose3 pose = sfm_data.GetPoseOrDie(left_view);
+        PosedStereoPair pair;
+        pair.name = left_view->s_Img_path;
+        pair.left = left_image->second;
+        pair.right = right_image->second;
+        pair.rotation = pose.rotation().transpose();
+        pair.translation = scale * (pose.center() - ppp.left_pos);
+        stereo_pairs.push_back(pair);
+    }
+}
+
 void AdjustModelPosition(std::vector<Vec3>& vec_points,
                          std::vector<Vec3>& vec_camPos,
                          const PPP& ppp)
@@ -171,10 +285,52 @@ std::string GlobalSfM::GetModelPath() const
     return output_dir + color_ply_name;
 }
 
-bool GlobalSfM::Solve() const
+bool GlobalSfM::Solve(SfMReport* report)
+{
+    model.clear();
+    real_model.clear();
+    stereo_pairs.clear();
+    bound = WinBoundary();
+    real_bound = WinBoundary();
+
+    SfMReport local_report;
+    SfMReport& stats = report ? *report : local_report;
+    stats = SfMReport();
+    stats.describer = describer.Name();
+
+    // written for failed runs too, the stages list shows how far it got
+    StageReport stages;
+    const bool success = SolveStages(stats, stages);
+
+    stages.SetInfo("images_dir", images_dir);
+    stages.SetInfo("describer", stats.describer);
+    stages.SetInfo("rig_mode", rig_mode ? 1 : 0);
+    stages.SetInfo("pair_window", pair_window);
+    stages.SetInfo("success", success ? 1 : 0);
+    stages.SetInfo("total_s", stats.total_s);
+
+    const MemoryTracker& memory = MemoryTracker::Instance();
+    for (int i = 0; i < MemoryTracker::SUBSYSTEM_COUNT; ++i)
+    {
+        const auto subsystem = static_cast<MemoryTracker::Subsystem>(i);
+        stages.SetInfo(std::string("peak_bytes_") + MemoryTracker::Name(subsystem), memory.Peak(subsystem));
+    }
+    stages.SetInfo("memory_budget_bytes", memory.Budget());
+    if (stlplus::folder_exists(output_dir))
+        stages.WriteJson(stlplus::create_filespec(output_dir, report_json_name));
+
+    return success;
+}
+
+bool GlobalSfM::SolveStages(SfMReport& stats, StageReport& stages)
 {
     openMVG::system::Timer total_timer;
     SfM_Data sfm_data;
+    // view image name -> image, empty when the views are read from disk
+    ImageMap images;
+
+    // rectified stereo input: shared distortion-free intrinsics and row-aligned rig pairs
+    bool rig = false;
 
     // image list
     {
@@ -197,11 +353,13 @@ bool GlobalSfM::Solve() const
 
 #ifdef USE_STEREO
         {
+            StageReport::Scope stage(stages, "rectification");
+            TRACE_SCOPE("sfm rectification");
             Rectifier rectifier(cv::Size(1920, 1080), maps_dir);
 
             const std::string rectified_dir = output_dir + "/rectified";
             images_root_path = rectified_dir;
-            if (!stlplus::folder_exists(rectified_dir))
+            if (export_rectified && !stlplus::folder_exists(rectified_dir))
             {
                 if (!stlplus::folder_create(rectified_dir))
                 {
@@ -210,6 +368,7 @@ bool GlobalSfM::Solve() const
                 }
             }
 
+            std::vector<std::pair<std::string, Rectifier::ImgIdx>> stereo_images;
             std::vector<std::string> vec_image = stlplus::folder_files(images_dir);
             std::sort(vec_image.begin(), vec_image.end());
             for (const auto& iter_image : vec_image)
@@ -237,20 +396,53 @@ bool GlobalSfM::Solve() const
                     continue;
                 }
 
-                cv::Mat img = cv::imread(sImageFilename);
-                img = rectifier.rectify(img, side_id);
-                cv::imwrite(stlplus::create_filespec(rectified_dir, rect_prefix + sImFilenamePart), img);
+                stereo_images.emplace_back(sImFilenamePart, side_id);
             }
 
-            std::this_thread::sleep_for(100ms);
+            // rectified images stay in memory for the feature stage, disk copies are optional
+            openMVG::system::Timer timer;
+            std::vector<cv::Mat> rectified(stereo_images.size());
+            ParallelFor(0, stereo_images.size(), [&](size_t begin, size_t end, int) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const auto& image = stereo_images[i];
+                    cv::Mat img = cv::imread(stlplus::create_filespec(images_dir, image.first));
+                    if (img.empty())
+                        continue;
+
+                    rectified[i] = rectifier.rectify(img, image.second);
+                    if (export_rectified)
+                        cv::imwrite(stlplus::create_filespec(rectified_dir, rect_prefix + image.first), rectified[i]);
+                }
+            });
+
+            for (size_t i = 0; i < stereo_images.size(); ++i)
+            {
+                if (!rectified[i].empty())
+                    images[rect_prefix + stereo_images[i].first] = rectified[i];
+            }
+            std::cout << "rectified " << images.size() << " images in (s): " << timer.elapsed() << std::endl;
+            stage.Count("images", images.size());
         }
 #endif
 
+        StageReport::Scope stage(stages, "listing");
+        TRACE_SCOPE("sfm listing");
+        rig = rig_mode && !images.empty();
         sfm_data.s_root_path = images_root_path;
         Views& views = sfm_data.views;
         Intrinsics& intrinsics = sfm_data.intrinsics;
 
-        std::vector<std::string> vec_image = stlplus::folder_files(images_root_path);
+        std::vector<std::string> vec_image;
+        if (!images.empty())
+        {
+            for (const auto& image : images)
+                vec_image.push_back(image.first);
+        }
+        else
+        {
+            vec_image = stlplus::folder_files(images_root_path);
+        }
         if (vec_image.empty())
         {
             std::cout << "rectified image empty\n";
@@ -263,18 +455,29 @@ bool GlobalSfM::Solve() const
             const std::string sImageFilename = stlplus::create_filespec(images_root_path, iter_image);
             const std::string sImFilenamePart = stlplus::filename_part(sImageFilename);
 
-            if (openMVG::image::GetFormat(sImageFilename.c_str()) == openMVG::image::Unknown)
+            double width, height;
+            auto image = images.find(iter_image);
+            if (image != images.end())
             {
-                std::cout << sImFilenamePart << ": Unkown image file format.\n";
-                continue;
+                width = image->second.cols;
+                height = image->second.rows;
             }
+            else
+            {
+                if (openMVG::image::GetFormat(sImageFilename.c_str()) == openMVG::image::Unknown)
+                {
+                    std::cout << sImFilenamePart << ": Unkown image file format.\n";
+                    continue;
+                }
 
-            ImageHeader imgHeader;
-            if (!openMVG::image::ReadImageHeader(sImageFilename.c_str(), &imgHeader))
-                continue;
+                ImageHeader imgHeader;
+                if (!openMVG::image::ReadImageHeader(sImageFilename.c_str(), &imgHeader))
+                    continue;
+
+                width = imgHeader.width;
+                height = imgHeader.height;
+            }
 
-            double width = imgHeader.width;
-            double height = imgHeader.height;
             double focal = CameraPara::fx;
             double ppx = CameraPara::cx;
             double ppy = CameraPara::cy;
@@ -282,8 +485,12 @@ bool GlobalSfM::Solve() const
             View v(iter_image, views.size(), views.size(), views.size(), width, height);
             views[v.id_view] = std::make_shared<View>(v);
 
-            intrinsics[v.id_intrinsic] =
-                std::make_shared<Pinhole_Intrinsic_Radial_K3>(width, height, focal, ppx, ppy, 0.0, 0.0, 0.0);
+            // rectified views share one undistorted camera, GroupSharedIntrinsics merges them
+            if (rig)
+                intrinsics[v.id_intrinsic] = std::make_shared<Pinhole_Intrinsic>(width, height, focal, ppx, ppy);
+            else
+                intrinsics[v.id_intrinsic] =
+                    std::make_shared<Pinhole_Intrinsic_Radial_K3>(width, height, focal, ppx, ppy, 0.0, 0.0, 0.0);
         }
 
         GroupSharedIntrinsics(sfm_data);
@@ -300,69 +507,293 @@ bool GlobalSfM::Solve() const
                   << "listed #File(s): " << vec_image.size() << "\n"
                   << "usable #File(s) listed in sfm_data: " << sfm_data.GetViews().size() << "\n"
                   << "usable #Intrinsic(s) listed in sfm_data: " << sfm_data.GetIntrinsics().size() << std::endl;
+        stage.Count("views", sfm_data.GetViews().size());
+        stage.Count("intrinsics", sfm_data.GetIntrinsics().size());
     }
 
     // feature && matches && sfm
     {
+        // regions are always written to the cache so the provider can page them out,
+        // earlier entries are only read back when use_cache is set
+        SfMCache cache(stlplus::create_filespec(output_dir, cache_folder));
+        const bool cached = use_cache && cache.Valid();
+        // feature cache key per view, in view id order
+        std::vector<SfMCache::Key> feature_keys(sfm_data.GetViews().size());
+
         // regions
-        std::unique_ptr<Regions> regions_type = std::make_unique<SIFT_Regions>();
-        std::shared_ptr<Regions_Provider> regions_provider =
-            std::make_shared<My_Regions_Provider>(regions_type);
+        std::unique_ptr<Regions> regions_type = describer.CreateRegionsType();
+        auto paged_provider = std::make_shared<PagedRegionsProvider>(*regions_type, cache, regions_memory_budget);
+        std::shared_ptr<Regions_Provider> regions_provider = paged_provider;
+
+        // gray image plus the scale space the describer builds from it are held under the budget
+        ByteBudget describe_budget(describe_memory_budget);
+        auto describe_view = [&](const View* view, Image_describer& image_describer,
+                                 Image<unsigned char>& imageGray) -> std::unique_ptr<Regions> {
+            const size_t bytes = size_t(view->ui_width) * view->ui_height * describer.BytesPerPixel();
+            describe_budget.Acquire(bytes);
+
+            std::unique_ptr<Regions> regions;
+            auto image = images.find(view->s_Img_path);
+            if (image != images.end())
+            {
+                ToGrayImage(image->second, imageGray);
+                regions = image_describer.Describe(imageGray, nullptr);
+            }
+            else if (ReadImage(stlplus::create_filespec(sfm_data.s_root_path, view->s_Img_path).c_str(), &imageGray))
+            {
+                regions = image_describer.Describe(imageGray, nullptr);
+            }
+            describe_budget.Release(bytes);
+
+            if (regions)
+                describer.Limit(*regions);
+            return regions;
+        };
+        paged_provider->SetDescribeFunc([&](IndexT id_view) {
+            std::unique_ptr<Image_describer> image_describer = describer.CreateDescriber();
+            Image<unsigned char> imageGray;
+            return describe_view(sfm_data.GetViews().at(id_view).get(), *image_describer, imageGray);
+        });
 
         // feature
         auto feats_provider = std::make_shared<Features_Provider>();
         {
+            StageReport::Scope stage(stages, "extraction");
+            TRACE_SCOPE("sfm extraction");
             system::Timer timer;
-            Image<unsigned char> imageGray;
-            auto my_regions_provider = std::dynamic_pointer_cast<My_Regions_Provider>(regions_provider);
 
-            C_Progress_display my_progress_bar(sfm_data.GetViews().size(),
+            std::vector<const View*> view_list;
+            for (const auto& view : sfm_data.GetViews())
+                view_list.push_back(view.second.get());
+
+            C_Progress_display my_progress_bar(view_list.size(),
                                                std::cout, "\n- EXTRACT FEATURES -\n");
+            std::mutex feats_mtx;
+            std::atomic<size_t> next_view{0};
+            std::atomic<size_t> cache_hits{0};
 
-            for (int i = 0; i < static_cast<int>(sfm_data.views.size()); ++i)
-            {
-                Views::const_iterator iterViews = sfm_data.views.begin();
-                std::advance(iterViews, i);
-                const View* view = iterViews->second.get();
-                const std::string
-                    sView_filename = stlplus::create_filespec(sfm_data.s_root_path, view->s_Img_path);
+            // workers pull views one at a time, each with its own describer
+            const int workers = std::max(1, std::min(ThreadCount(), static_cast<int>(view_list.size())));
+            auto extract = [&](size_t, size_t, int) {
+                std::unique_ptr<Image_describer> image_describer = describer.CreateDescriber();
+                Image<unsigned char> imageGray;
 
-                if (!ReadImage(sView_filename.c_str(), &imageGray))
-                    continue;
+                for (size_t i = next_view++; i < view_list.size(); i = next_view++)
+                {
+                    TRACE_SCOPE("sfm describe view");
+                    const View* view = view_list[i];
+                    const std::string
+                        sView_filename = stlplus::create_filespec(sfm_data.s_root_path, view->s_Img_path);
+                    auto image = images.find(view->s_Img_path);
 
-                std::unique_ptr<Image_describer> image_describer =
-                    std::make_unique<SIFT_Image_describer>();
-                auto regions = image_describer->Describe(imageGray, nullptr);
-                feats_provider->feats_per_view[view->id_view] = regions->GetRegionsPositions();
+                    if (cache.Valid())
+                    {
+                        const auto content_key = image != images.end() ? SfMCache::HashImage(image->second)
+                                                                       : SfMCache::HashFile(sView_filename);
+                        feature_keys[i] = SfMCache::Combine(content_key, describer.Name());
+                    }
 
-                std::unique_ptr<features::Regions> regions_ptr(regions_type->EmptyClone());
-                regions_ptr = std::move(regions);
-                my_regions_provider->insert(view->id_view, std::move(regions_ptr));
+                    std::unique_ptr<Regions> regions;
+                    bool spilled = false;
+                    if (cached)
+                    {
+                        regions.reset(regions_type->EmptyClone());
+                        spilled = cache.LoadRegions(feature_keys[i], *regions);
+                        if (spilled)
+                            ++cache_hits;
+                        else
+                            regions.reset();
+                    }
 
-                ++my_progress_bar;
-            }
+                    if (!regions)
+                    {
+                        regions = describe_view(view, *image_describer, imageGray);
+                        if (regions)
+                            spilled = cache.SaveRegions(feature_keys[i], *regions);
+                    }
 
-            std::cout << "Task done in (s): " << timer.elapsed() << std::endl;
+                    if (regions)
+                    {
+                        auto positions = regions->GetRegionsPositions();
+                        paged_provider->insert(view->id_view, std::move(regions), feature_keys[i], spilled);
+
+                        std::lock_guard<std::mutex> lock(feats_mtx);
+                        feats_provider->feats_per_view[view->id_view] = std::move(positions);
+                    }
+
+                    std::lock_guard<std::mutex> lock(feats_mtx);
+                    ++my_progress_bar;
+                }
+            };
+            ParallelFor(0, workers, extract, workers);
+
+            stats.views = view_list.size();
+            stats.extract_s = timer.elapsed();
+            std::cout << "Task done in (s): " << stats.extract_s << std::endl;
+            if (cached)
+                std::cout << "regions from cache: " << cache_hits << " / " << view_list.size() << std::endl;
+            std::cout << "resident regions (MB): " << paged_provider->ResidentBytes() / (1 << 20) << std::endl;
+
+            size_t features = 0;
+            for (const auto& feats : feats_provider->feats_per_view)
+                features += feats.second.size();
+            stage.Count("views", view_list.size());
+            stage.Count("features", features);
+            stage.Count("cache_hits", cache_hits);
+            stage.Count("resident_regions_bytes", paged_provider->ResidentBytes());
         }
 
         // matches
         auto matches_provider = std::make_shared<Matches_Provider>();
         {
-            PairWiseMatches map_PutativesMatches;
-            Pair_Set pairs = exhaustivePairs(sfm_data.GetViews().size());
+            openMVG::system::Timer timer;
+
+            // rig partner plus a temporal window instead of every pair, exhaustive when pair_window < 0
+            RigPairBuilder pair_builder(left_prefix, right_prefix, pair_window, retrieval_count);
+            const std::string pairs_tag = pair_window < 0 ? "exhaustive" : pair_builder.Tag();
+
+            // matches depend on every view's regions, the view order and the pair selection
+            const auto putative_key = SfMCache::Combine(SfMCache::Combine(0, feature_keys), putative_tag + pairs_tag);
+            const auto geometric_key = SfMCache::Combine(putative_key, rig ? geometric_tag + rig_tag : geometric_tag);
+
+            // every stage is reported on cached runs too, cache_hit tells them apart
+            PairWiseMatches map_GeometricMatches, map_PutativesMatches;
+            const bool geometric_hit = cached && cache.LoadMatches(geometric_key, map_GeometricMatches);
+            const bool putative_hit = cached && cache.LoadMatches(putative_key, map_PutativesMatches);
+            {
+                StageReport::Scope stage(stages, "matching");
+                TRACE_SCOPE("sfm matching");
+                Pair_Set pairs;
+                if (pair_window < 0)
+                {
+                    pairs = exhaustivePairs(sfm_data.GetViews().size());
+                }
+                else
+                {
+                    if (retrieval_count > 0)
+                    {
+                        std::vector<std::pair<IndexT, std::string>> view_list;
+                        for (const auto& view : sfm_data.GetViews())
+                            view_list.emplace_back(view.first, view.second->s_Img_path);
+
+                        std::vector<cv::Mat> thumbs(view_list.size());
+                        ParallelFor(0, view_list.size(), [&](size_t begin, size_t end, int) {
+                            for (size_t i = begin; i < end; ++i)
+                            {
+                                auto image = images.find(view_list[i].second);
+                                if (image != images.end())
+                                    cv::resize(image->second, thumbs[i], cv::Size(), 0.125, 0.125, cv::INTER_AREA);
+                                else
+                                    thumbs[i] = cv::imread(stlplus::create_filespec(sfm_data.s_root_path, view_list[i].second),
+                                                           cv::IMREAD_REDUCED_GRAYSCALE_8);
+                            }
+                        });
+
+                        for (size_t i = 0; i < view_list.size(); ++i)
+                        {
+                            if (!thumbs[i].empty())
+                                pair_builder.AddThumbnail(view_list[i].first, thumbs[i]);
+                        }
+                    }
+
+                    pairs = pair_builder.Build(sfm_data);
+                }
+                stats.pairs = pairs.size();
+
+                if (putative_hit)
+                {
+                    std::cout << "putative matches from cache: " << map_PutativesMatches.size() << " pairs\n";
+                }
+                else if (!geometric_hit)
+                {
+                    std::cout << "matching " << pairs.size() << " pairs of "
+                              << sfm_data.GetViews().size() << " views\n";
+
+                    std::unique_ptr<Matcher> collectionMatcher = describer.CreateMatcher();
+                    collectionMatcher->Match(regions_provider, pairs, map_PutativesMatches);
+                    if (paged_provider->Failures())
+                    {
+                        std::cout << "matching lost the regions of " << paged_provider->Failures() << " views\n";
+                        return false;
+                    }
+                    if (cached)
+                        cache.SaveMatches(putative_key, map_PutativesMatches);
+                }
+                stage.Count("cache_hit", putative_hit || geometric_hit ? 1 : 0);
+                stage.Count("pairs", pairs.size());
+                stage.Count("putative_pairs", map_PutativesMatches.size());
+                stage.Count("regions_paged_in", paged_provider->PageIns());
+            }
+
+            {
+                StageReport::Scope stage(stages, "geometric_filter");
+                TRACE_SCOPE("sfm geometric_filter");
+
+                if (geometric_hit)
+                {
+                    std::cout << "geometric matches from cache: " << map_GeometricMatches.size() << " pairs\n";
+                }
+                else
+                {
+                    // rig pairs are checked against the rectified epipolar lines, the rest go through a-contrario RANSAC
+                    PairWiseMatches map_RigMatches;
+                    if (rig)
+                    {
+                        for (const auto& partner : pair_builder.Partners(sfm_data))
+                        {
+                            const bool left_first = partner.first < partner.second;
+                            const Pair pair = left_first ? Pair(partner.first, partner.second)
+                                                         : Pair(partner.second, partner.first);
+                            auto putative = map_PutativesMatches.find(pair);
+                            if (putative == map_PutativesMatches.end())
+                                continue;
+
+                            auto inliers = FilterRigMatches(putative->second,
+                                                            feats_provider->feats_per_view[partner.first],
+                                                            feats_provider->feats_per_view[partner.second],
+                                                            left_first);
+                            if (inliers.size() >= rig_min_matches)
+                                map_RigMatches[pair] = std::move(inliers);
+                            map_PutativesMatches.erase(putative);
+                        }
+                        std::cout << "rig pairs kept by the epipolar check: " << map_RigMatches.size() << "\n";
+                    }
 
-            std::unique_ptr<Matcher> collectionMatcher =
-                std::make_unique<Cascade_Hashing_Matcher_Regions>(0.8);
-            collectionMatcher->Match(regions_provider, pairs, map_PutativesMatches);
+                    auto filter_ptr = std::make_unique<ImageCollectionGeometricFilter>(
+                        &sfm_data, regions_provider);
+                    filter_ptr->Robust_model_estimation(
+                        GeometricFilter_FMatrix_AC(4.0, 2048),
+                        map_PutativesMatches, false, 0.6);
+                    if (paged_provider->Failures())
+                    {
+                        std::cout << "geometric filter lost the regions of " << paged_provider->Failures() << " views\n";
+                        return false;
+                    }
+                    map_GeometricMatches = filter_ptr->Get_geometric_matches();
+                    map_GeometricMatches.insert(map_RigMatches.begin(), map_RigMatches.end());
+                    std::cout << "regions paged in during matching: " << paged_provider->PageIns() << "\n";
+                    if (cached)
+                        cache.SaveMatches(geometric_key, map_GeometricMatches);
+                }
 
-            auto filter_ptr = std::make_unique<ImageCollectionGeometricFilter>(
-                &sfm_data, regions_provider);
-            filter_ptr->Robust_model_estimation(
-                GeometricFilter_FMatrix_AC(4.0, 2048),
-                map_PutativesMatches, false, 0.6);
-            PairWiseMatches map_GeometricMatches = filter_ptr->Get_geometric_matches();
+                // partner pairs only get into the geometric matches through the rig check
+                size_t rig_pairs = 0;
+                if (rig)
+                {
+                    for (const auto& partner : pair_builder.Partners(sfm_data))
+                        rig_pairs += map_GeometricMatches.count(partner.first < partner.second
+                                                                    ? Pair(partner.first, partner.second)
+                                                                    : Pair(partner.second, partner.first));
+                }
+                stage.Count("cache_hit", geometric_hit ? 1 : 0);
+                stage.Count("rig_pairs", rig_pairs);
+                stage.Count("geometric_pairs", map_GeometricMatches.size());
+            }
 
             matches_provider->pairWise_matches_ = map_GeometricMatches;
+            stats.geometric_pairs = map_GeometricMatches.size();
+            stats.match_s = timer.elapsed();
+            std::cout << "matching took (s): " << stats.match_s << std::endl;
         }
 
         // golbal sfm
@@ -374,7 +805,9 @@ bool GlobalSfM::Solve() const
             sfmEngine.SetMatchesProvider(matches_provider.get());
 
             // Configure reconstruction parameters
-            sfmEngine.Set_Intrinsics_Refinement_Type(Intrinsic_Parameter_Type::ADJUST_ALL);
+            // the rectified camera is calibrated, only poses and structure are refined
+            sfmEngine.Set_Intrinsics_Refinement_Type(rig ? Intrinsic_Parameter_Type::NONE
+                                                         : Intrinsic_Parameter_Type::ADJUST_ALL);
             sfmEngine.Set_Use_Motion_Prior(false);
 
             // Configure motion averaging method
@@ -383,50 +816,72 @@ bool GlobalSfM::Solve() const
             sfmEngine.SetTranslationAveragingMethod(
                 ETranslationAveragingMethod::TRANSLATION_AVERAGING_SOFTL1);
 
-            openMVG::system::Timer timer;
-            if (!sfmEngine.Process())
             {
-                std::cout << "engine process fail\n";
-                return false;
+                StageReport::Scope stage(stages, "global_engine");
+                TRACE_SCOPE("sfm global_engine");
+                openMVG::system::Timer timer;
+                if (!sfmEngine.Process())
+                {
+                    std::cout << "engine process fail\n";
+                    return false;
+                }
+
+                stats.reconstruct_s = timer.elapsed();
+                stats.reconstructed_views = sfmEngine.Get_SfM_Data().GetPoses().size();
+                stats.landmarks = sfmEngine.Get_SfM_Data().GetLandmarks().size();
+                std::cout << " Total Ac-Global-Sfm took (s): " << stats.reconstruct_s << std::endl;
+                stage.Count("poses", stats.reconstructed_views);
+                stage.Count("landmarks", stats.landmarks);
             }
+            const SfM_Data& result = sfmEngine.Get_SfM_Data();
 
-            std::cout << " Total Ac-Global-Sfm took (s): " << timer.elapsed() << std::endl;
+            // one colorization pass for both models
+            std::vector<Vec3> vec_3dPoints, vec_tracksColor, vec_camPosition;
+            std::vector<Vec3> vec_realPoints, vec_realCamPosition;
+            bool colorized = false;
+            {
+                StageReport::Scope stage(stages, "colorization");
+                TRACE_SCOPE("sfm colorization");
+                colorized = ColorizeLandmarks(result, images, vec_3dPoints, vec_tracksColor);
+                if (colorized)
+                {
+                    PPP ppp;
+                    vec_camPosition = GetCameraPositionsNew(result, ppp);
+                    model = ToModel(vec_3dPoints, vec_tracksColor, vec_camPosition, bound);
+
+                    // metric scale from the rig baseline, origin at the reference left camera
+                    vec_realPoints = vec_3dPoints;
+                    vec_realCamPosition = vec_camPosition;
+                    AdjustModelPosition(vec_realPoints, vec_realCamPosition, ppp);
+                    real_model = ToModel(vec_realPoints, vec_tracksColor, vec_realCamPosition, real_bound);
+                    if (keep_stereo_pairs && rig && ppp.Distance() > 0)
+                        CollectStereoPairs(result, images, ppp, stereo_pairs);
+                }
+                stage.Count("points", vec_3dPoints.size());
+                stage.Count("stereo_pairs", stereo_pairs.size());
+            }
 
-            openMVG::sfm::Save(sfmEngine.Get_SfM_Data(),
-                               stlplus::create_filespec(output_dir, "cloud_and_poses", ".ply"),
-                               ESfM_Data(ALL));
+            {
+                StageReport::Scope stage(stages, "export");
+                TRACE_SCOPE("sfm export");
+                openMVG::sfm::Save(result,
+                                   stlplus::create_filespec(output_dir, "cloud_and_poses", ".ply"),
+                                   ESfM_Data(ALL));
 
-            openMVG::sfm::Save(sfmEngine.Get_SfM_Data(),
-                               stlplus::create_filespec(output_dir, "sfm_data", ".bin"),
-                               ESfM_Data(ALL));
+                openMVG::sfm::Save(result,
+                                   stlplus::create_filespec(output_dir, "sfm_data", ".bin"),
+                                   ESfM_Data(ALL));
 
-            // color ply
-            {
-                std::vector<Vec3> vec_3dPoints, vec_tracksColor;
-                if (ColorizeTracks(sfmEngine.Get_SfM_Data(), vec_3dPoints, vec_tracksColor))
+                if (colorized && export_ply)
                 {
-                    auto vec_camPosition = GetCameraPositions(sfmEngine.Get_SfM_Data());
                     if (!plyHelper::exportToPly(vec_3dPoints, vec_camPosition, output_dir + color_ply_name, &vec_tracksColor))
                     {
                         std::cout << "export " << color_ply_name << " fail\n";
                         return false;
                     }
-                }
-            }
-
-            // resize_ply
-            {
-                std::vector<Vec3> vec_3dPoints, vec_tracksColor;
-                if (ColorizeTracks(sfmEngine.Get_SfM_Data(), vec_3dPoints, vec_tracksColor))
-                {
-                    PPP ppp;
-                    auto vec_camPosition = GetCameraPositionsNew(sfmEngine.Get_SfM_Data(), ppp);
-                    AdjustModelPosition(vec_3dPoints, vec_camPosition, ppp);
-                    if (!plyHelper::exportToPly(vec_3dPoints, vec_camPosition, output_dir + "real.ply", &vec_tracksColor))
+                    if (!plyHelper::exportToPly(vec_realPoints, vec_realCamPosition, output_dir + real_ply_name, &vec_tracksColor))
                     {
-                        std::cout << "export "
-                                  << "real.ply"
-                                  << " fail\n";
+                        std::cout << "export " << real_ply_name << " fail\n";
                         return false;
                     }
                 }
@@ -434,8 +889,10 @@ bool GlobalSfM::Solve() const
         }
     }
 
+    stats.total_s = total_timer.elapsed();
+    stats.success = true;
     std::cout << std::endl
-              << "--- Total took (s): " << total_timer.elapsed() << " ---\n\n";
+              << "--- Total took (s): " << stats.total_s << " ---\n\n";
 
     std::this_thread::sleep_for(100ms);
 
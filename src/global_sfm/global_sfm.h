@@ -1,17 +1,96 @@
 #pragma once
 #include <string>
 
+#include "def/model.h"
+#include "def/win_boundary.h"
+#include "describer_preset.h"
+#include "posed_stereo_pair.h"
+#include <vector>
+
+struct SfMReport
+{
+    std::string describer;
+    size_t views = 0;
+    size_t pairs = 0;
+    size_t geometric_pairs = 0;
+    size_t reconstructed_views = 0;
+    size_t landmarks = 0;
+
+    double extract_s = 0;
+    double match_s = 0;
+    double reconstruct_s = 0;
+    double total_s = 0;
+
+    bool success = false;
+};
+
+class StageReport;
+
 class GlobalSfM
 {
 public:
     GlobalSfM(const std::string images_dir,
               const std::string output_dir);
 
-    bool Solve() const;
+    // report gets the stage timings and counts, success is only set when every stage ran.
+    // every run also writes wall, cpu and peak rss per stage to output_dir/sfm_report.json
+    bool Solve(SfMReport* report = nullptr);
     std::string GetModelPath() const;
 
+    // colored landmarks after the green camera centers, in reconstruction units
+    const Model& GetModel() const { return model; }
+    const WinBoundary& GetBoundary() const { return bound; }
+    // the same model scaled by the rig baseline with the reference left camera at the origin
+    const Model& GetRealModel() const { return real_model; }
+    const WinBoundary& GetRealBoundary() const { return real_bound; }
+    // rectified rig pairs whose left view got a pose, posed in the real model frame.
+    // empty unless SetKeepStereoPairs(true) was called before Solve
+    const std::vector<PosedStereoPair>& GetStereoPairs() const { return stereo_pairs; }
+
+    // keep a jpeg copy of the rectified images under output_dir/rectified
+    void SetExportRectified(bool export_rectified) { this->export_rectified = export_rectified; }
+    // write color.ply and real.ply to output_dir, the models are kept in memory either way
+    void SetExportPly(bool export_ply) { this->export_ply = export_ply; }
+    // keep the rectified images of the posed rig pairs for GetStereoPairs, they are
+    // released with the rest of the images when Solve returns otherwise
+    void SetKeepStereoPairs(bool keep) { keep_stereo_pairs = keep; }
+    // bytes of images and scale spaces being described at once by the extraction workers,
+    // the regions kept afterwards are bounded by SetRegionsMemoryBudget
+    void SetDescribeMemoryBudget(size_t bytes) { describe_memory_budget = bytes; }
+    // reuse regions and matches stored under output_dir/cache by earlier runs
+    void SetUseCache(bool use_cache) { this->use_cache = use_cache; }
+    // match each rig frame with the frames up to window away, a negative window matches every pair
+    void SetPairWindow(int window) { pair_window = window; }
+    // extra pairs per frame from thumbnail retrieval, for loop closures outside the window
+    void SetRetrievalCount(int count) { retrieval_count = count; }
+    // rectified input: fixed shared pinhole intrinsics, left/right pairs verified by the rig geometry
+    void SetRigMode(bool rig_mode) { this->rig_mode = rig_mode; }
+    // regions kept in memory during matching, the rest is paged from output_dir/cache
+    void SetRegionsMemoryBudget(size_t bytes) { regions_memory_budget = bytes; }
+    void SetDescriber(const DescriberPreset& describer) { this->describer = describer; }
+
+private:
+    bool SolveStages(SfMReport& stats, StageReport& stages);
+
 private:
     const std::string images_dir;
     const std::string output_dir;
     const std::string maps_dir = "/home/ospacer/Documents/resource/map";
+
+    bool export_rectified = false;
+    bool export_ply = true;
+    bool keep_stereo_pairs = false;
+    size_t describe_memory_budget = size_t(2) << 30;
+    bool use_cache = true;
+    int pair_window = 3;
+    int retrieval_count = 2;
+    bool rig_mode = true;
+    size_t regions_memory_budget = size_t(1) << 30;
+    DescriberPreset describer;
+
+    Model model;
+    WinBoundary bound;
+    Model real_model;
+    WinBoundary real_bound;
+    std::vector<PosedStereoPair> stereo_pairs;
 };
@@ -1,13 +1,61 @@
 #include "global_sfm.h"
+#include "profiling/tracked_mat_allocator.h"
+#include "profiling/trace.h"
 
-int main()
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// global_sfm [images_dir] [output_dir] [describer preset | bench]
+// bench solves with every preset into output_dir/<preset>/ and prints a comparison
+int main(int argc, char** argv)
 {
-    const std::string images_dir = "/home/ospacer/Documents/resource/images/heart_model3s/mix/";
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
+    TrackedMatAllocator::Install();
+    const std::string images_dir = argc > 1 ? argv[1] : "/home/ospacer/Documents/resource/images/heart_model3s/mix/";
     //"/home/ospacer/Documents/3d/project/file/iiii/images/";
-    const std::string output_dir = "../output/";
-    auto global_sfm_solver = GlobalSfM(images_dir, output_dir);
+    const std::string output_dir = argc > 2 ? argv[2] : "../output/";
+    const std::string mode = argc > 3 ? argv[3] : "";
+
+    if (mode != "bench")
+    {
+        auto global_sfm_solver = GlobalSfM(images_dir, output_dir);
+
+        DescriberPreset preset;
+        if (!mode.empty() && !DescriberPreset::Parse(mode, preset))
+        {
+            std::cout << "unknown describer preset: " << mode << std::endl;
+            return 1;
+        }
+        global_sfm_solver.SetDescriber(preset);
+
+        return global_sfm_solver.Solve() ? 0 : 1;
+    }
+
+    std::vector<SfMReport> reports;
+    for (const auto type : DescriberPreset::All())
+    {
+        const DescriberPreset preset(type);
+        auto global_sfm_solver = GlobalSfM(images_dir, output_dir + preset.Name() + "/");
+        global_sfm_solver.SetDescriber(preset);
+        // time the stages, not the cache
+        global_sfm_solver.SetUseCache(false);
+
+        SfMReport report;
+        global_sfm_solver.Solve(&report);
+        reports.push_back(report);
+    }
 
-    global_sfm_solver.Solve();
+    std::printf("\n%-12s %8s %8s %10s %10s %12s %10s %8s\n",
+                "describer", "extract", "match", "recon", "total", "views", "pairs", "points");
+    for (const auto& report : reports)
+    {
+        std::printf("%-12s %7.2fs %7.2fs %9.2fs %9.2fs %5zu / %-4zu %4zu/%-5zu %8zu %s\n",
+                    report.describer.c_str(), report.extract_s, report.match_s, report.reconstruct_s, report.total_s,
+                    report.reconstructed_views, report.views, report.geometric_pairs, report.pairs,
+                    report.landmarks, report.success ? "" : "FAILED");
+    }
 
     return 0;
-}
\ No newline at end of file
+}
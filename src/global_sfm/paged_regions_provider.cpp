@@ -0,0 +1,170 @@
+#include "paged_regions_provider.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <openMVG/features/feature.hpp>
+
+#include "profiling/memory_tracker.h"
+
+using namespace openMVG;
+
+PagedRegionsProvider::PagedRegionsProvider(const features::Regions& region_type,
+                                           const SfMCache& cache, size_t budget)
+    : Regions_Provider()
+    , cache(cache)
+    , budget(budget)
+{
+    region_type_.reset(region_type.EmptyClone());
+}
+
+PagedRegionsProvider::~PagedRegionsProvider()
+{
+    MemoryTracker::Instance().Release(MemoryTracker::REGIONS, resident_bytes);
+}
+
+size_t PagedRegionsProvider::Bytes(const features::Regions& regions)
+{
+    // descriptors are stored as bytes for both scalar and binary regions
+    return regions.RegionCount() * (regions.DescriptorLength() + sizeof(features::SIOPointFeature));
+}
+
+void PagedRegionsProvider::insert(IndexT id_view, std::shared_ptr<features::Regions> regions,
+                                  SfMCache::Key key, bool spilled)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto& entry = entries[id_view];
+    entry.key = key;
+    entry.spilled = spilled;
+    entry.bytes = Bytes(*regions);
+
+    cache_[id_view] = std::move(regions);
+    Touch(id_view, entry);
+    Evict();
+}
+
+std::shared_ptr<features::Regions> PagedRegionsProvider::get(const IndexT x) const
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    auto found = entries.find(x);
+    if (found == entries.end())
+        return nullptr;
+
+    // entries are never erased, the reference outlives the unlocked read
+    Entry& entry = found->second;
+    loaded.wait(lock, [&entry]() { return !entry.loading; });
+    if (!entry.resident)
+    {
+        entry.loading = true;
+        const SfMCache::Key key = entry.key;
+        lock.unlock();
+
+        std::shared_ptr<features::Regions> regions(region_type_->EmptyClone());
+        if (!cache.LoadRegions(key, *regions))
+        {
+            std::cout << "regions of view " << x << " can't be read back from the cache, describing it again\n";
+            regions.reset();
+            if (describe_func)
+                regions = describe_func(x);
+            // the cache copy is restored, eviction keeps working
+            if (regions)
+                cache.SaveRegions(key, *regions);
+        }
+
+        lock.lock();
+        entry.loading = false;
+        loaded.notify_all();
+        if (!regions)
+        {
+            std::cout << "regions of view " << x << " are lost\n";
+            ++failures;
+            return std::shared_ptr<features::Regions>(region_type_->EmptyClone());
+        }
+
+        cache_[x] = std::move(regions);
+        ++page_ins;
+    }
+
+    // keep the result alive for the caller even if it gets evicted right away
+    auto regions = cache_.at(x);
+    Touch(x, entry);
+    Evict();
+
+    return regions;
+}
+
+void PagedRegionsProvider::Touch(IndexT id, Entry& entry) const
+{
+    if (entry.resident)
+    {
+        lru.splice(lru.begin(), lru, entry.lru_pos);
+        return;
+    }
+
+    lru.push_front(id);
+    entry.lru_pos = lru.begin();
+    entry.resident = true;
+    resident_bytes += entry.bytes;
+    if (entry.spilled)
+        spilled_bytes += entry.bytes;
+    MemoryTracker::Instance().Allocate(MemoryTracker::REGIONS, entry.bytes);
+}
+
+size_t PagedRegionsProvider::EvictTarget() const
+{
+    const MemoryTracker& tracker = MemoryTracker::Instance();
+    if (!tracker.OverBudget())
+        return budget;
+
+    // images and models over the budget can't be paged out, evicting every
+    // page would then only turn each get into a reload
+    const size_t over = tracker.TotalLive() - tracker.Budget();
+    if (over > spilled_bytes)
+        return budget;
+
+    return std::min(budget, resident_bytes - over);
+}
+
+void PagedRegionsProvider::Evict() const
+{
+    // the most recently used entry always stays
+    auto it = lru.end();
+    const size_t target = EvictTarget();
+    while (resident_bytes > target && it != lru.begin())
+    {
+        --it;
+        if (it == lru.begin())
+            break;
+
+        auto& entry = entries.at(*it);
+        if (!entry.spilled)
+            continue;
+
+        cache_.erase(*it);
+        entry.resident = false;
+        resident_bytes -= entry.bytes;
+        spilled_bytes -= entry.bytes;
+        MemoryTracker::Instance().Release(MemoryTracker::REGIONS, entry.bytes);
+        it = lru.erase(it);
+    }
+}
+
+size_t PagedRegionsProvider::ResidentBytes() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return resident_bytes;
+}
+
+size_t PagedRegionsProvider::PageIns() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return page_ins;
+}
+
+size_t PagedRegionsProvider::Failures() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return failures;
+}
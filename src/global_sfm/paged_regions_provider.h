@@ -0,0 +1,79 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <openMVG/sfm/pipelines/sfm_regions_provider.hpp>
+
+#include "sfm_cache.h"
+
+// regions provider that keeps at most budget bytes of regions resident,
+// least recently used regions are dropped and read back from the cache on demand.
+// regions that aren't in the cache stay resident. resident bytes are counted
+// under MemoryTracker::REGIONS. once the tracker is over budget more regions are
+// spilled, but only when dropping them can get the process back under it.
+// page ins read the cache outside the lock, other views stay available meanwhile
+class PagedRegionsProvider : public openMVG::sfm::Regions_Provider
+{
+public:
+    // describes the view again, nullptr when its image can't be read either
+    using DescribeFunc = std::function<std::unique_ptr<openMVG::features::Regions>(openMVG::IndexT)>;
+
+    PagedRegionsProvider(const openMVG::features::Regions& region_type,
+                         const SfMCache& cache, size_t budget);
+    ~PagedRegionsProvider() override;
+
+    // spilled tells the regions are stored in the cache under key and may be evicted
+    void insert(openMVG::IndexT id_view, std::shared_ptr<openMVG::features::Regions> regions,
+                SfMCache::Key key, bool spilled);
+
+    // called for spilled regions the cache can't give back, from the getting thread
+    void SetDescribeFunc(DescribeFunc describe_func) { this->describe_func = std::move(describe_func); }
+
+    // regions missing from the cache are described again, empty regions when that
+    // fails too. the matchers dereference what they get, so never nullptr for a known view
+    std::shared_ptr<openMVG::features::Regions> get(const openMVG::IndexT x) const override;
+
+    size_t ResidentBytes() const;
+    size_t PageIns() const;
+    // gets that returned empty regions, the matches of such a run are wrong
+    size_t Failures() const;
+
+    static size_t Bytes(const openMVG::features::Regions& regions);
+
+private:
+    struct Entry
+    {
+        SfMCache::Key key = 0;
+        bool spilled = false;
+        size_t bytes = 0;
+        // position in lru while resident
+        std::list<openMVG::IndexT>::iterator lru_pos;
+        bool resident = false;
+        // a get is reading it back from the cache
+        bool loading = false;
+    };
+
+    void Touch(openMVG::IndexT id, Entry& entry) const;
+    // resident bytes Evict brings the regions down to
+    size_t EvictTarget() const;
+    void Evict() const;
+
+private:
+    const SfMCache& cache;
+    const size_t budget;
+    DescribeFunc describe_func;
+
+    mutable std::mutex mtx;
+    mutable std::condition_variable loaded;
+    mutable std::unordered_map<openMVG::IndexT, Entry> entries;
+    // front is the most recently used
+    mutable std::list<openMVG::IndexT> lru;
+    mutable size_t resident_bytes = 0;
+    mutable size_t spilled_bytes = 0; // resident and evictable
+    mutable size_t page_ins = 0;
+    mutable size_t failures = 0;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <Eigen/Geometry>
+#include <opencv2/core.hpp>
+#include <string>
+
+// rectified rig images with the left camera pose of the reconstruction
+struct PosedStereoPair
+{
+    std::string name; // left view
+    cv::Mat left;     // BGR
+    cv::Mat right;    // BGR
+
+    // left camera -> world, stored apart to keep the struct free of aligned eigen types
+    Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+
+    Eigen::Isometry3d Pose() const
+    {
+        Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+        pose.linear() = rotation;
+        pose.translation() = translation;
+        return pose;
+    }
+};
@@ -0,0 +1,177 @@
+#include "rig_pair_builder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include <opencv2/imgproc.hpp>
+#include <third_party/stlplus3/filesystemSimplified/file_system.hpp>
+
+using namespace openMVG;
+
+namespace
+{
+const cv::Size thumbnail_size(32, 18);
+
+void AddPair(IndexT a, IndexT b, Pair_Set& pairs)
+{
+    if (a == UndefinedIndexT || b == UndefinedIndexT || a == b)
+        return;
+
+    pairs.insert(a < b ? Pair(a, b) : Pair(b, a));
+}
+
+// frame number right after prefix, -1 when the name has none
+int ParseFrame(const std::string& name, const std::string& prefix)
+{
+    const auto pos = name.find(prefix);
+    if (pos == std::string::npos)
+        return -1;
+
+    const auto begin = pos + prefix.size();
+    auto end = begin;
+    while (end < name.size() && std::isdigit(static_cast<unsigned char>(name[end])))
+        ++end;
+    if (end == begin)
+        return -1;
+
+    return std::atoi(name.substr(begin, end - begin).c_str());
+}
+} // namespace
+
+RigPairBuilder::RigPairBuilder(const std::string& left_prefix, const std::string& right_prefix,
+                               int window, int retrieval_count)
+    : left_prefix(left_prefix)
+    , right_prefix(right_prefix)
+    , window(std::max(0, window))
+    , retrieval_count(std::max(0, retrieval_count))
+{
+}
+
+void RigPairBuilder::AddThumbnail(IndexT view_id, const cv::Mat& img)
+{
+    cv::Mat gray = img;
+    if (img.channels() == 3)
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+
+    cv::Mat thumb;
+    cv::resize(gray, thumb, thumbnail_size, 0, 0, cv::INTER_AREA);
+    thumb.convertTo(thumb, CV_32F);
+
+    thumb -= cv::mean(thumb)[0];
+    const double norm = cv::norm(thumb);
+    if (norm > 0)
+        thumb /= norm;
+
+    thumbnails[view_id] = thumb;
+}
+
+std::string RigPairBuilder::Tag() const
+{
+    return "rig_w" + std::to_string(window) + "_r" + std::to_string(retrieval_count);
+}
+
+void RigPairBuilder::AddFramePairs(const RigFrame& a, const RigFrame& b, Pair_Set& pairs) const
+{
+    AddPair(a.left, b.left, pairs);
+    AddPair(a.left, b.right, pairs);
+    AddPair(a.right, b.left, pairs);
+    AddPair(a.right, b.right, pairs);
+}
+
+double RigPairBuilder::Similarity(IndexT a, IndexT b) const
+{
+    auto thumb_a = thumbnails.find(a);
+    auto thumb_b = thumbnails.find(b);
+    if (thumb_a == thumbnails.end() || thumb_b == thumbnails.end())
+        return -1.0;
+
+    return thumb_a->second.dot(thumb_b->second);
+}
+
+std::vector<RigPairBuilder::RigFrame> RigPairBuilder::Sequence(const sfm::SfM_Data& sfm_data,
+                                                               std::vector<IndexT>* unparsed) const
+{
+    // frame number -> views, std::map keeps capture order
+    std::map<int, RigFrame> frames;
+
+    for (const auto& view : sfm_data.GetViews())
+    {
+        const auto name = stlplus::basename_part(view.second->s_Img_path);
+        const int left = ParseFrame(name, left_prefix);
+        const int right = ParseFrame(name, right_prefix);
+
+        if (left >= 0)
+            frames[left].left = view.first;
+        else if (right >= 0)
+            frames[right].right = view.first;
+        else if (unparsed)
+            unparsed->push_back(view.first);
+    }
+
+    std::vector<RigFrame> sequence;
+    for (const auto& frame : frames)
+        sequence.push_back(frame.second);
+
+    return sequence;
+}
+
+std::vector<std::pair<IndexT, IndexT>> RigPairBuilder::Partners(const sfm::SfM_Data& sfm_data) const
+{
+    std::vector<std::pair<IndexT, IndexT>> partners;
+    for (const auto& frame : Sequence(sfm_data))
+    {
+        if (frame.left != UndefinedIndexT && frame.right != UndefinedIndexT)
+            partners.emplace_back(frame.left, frame.right);
+    }
+
+    return partners;
+}
+
+Pair_Set RigPairBuilder::Build(const sfm::SfM_Data& sfm_data) const
+{
+    std::vector<IndexT> unparsed;
+    const auto sequence = Sequence(sfm_data, &unparsed);
+
+    Pair_Set pairs;
+    for (size_t i = 0; i < sequence.size(); ++i)
+    {
+        AddPair(sequence[i].left, sequence[i].right, pairs);
+        for (size_t j = i + 1; j < sequence.size() && j <= i + window; ++j)
+            AddFramePairs(sequence[i], sequence[j], pairs);
+    }
+
+    // loop closures, frames outside the window whose left thumbnails correlate best
+    if (retrieval_count > 0)
+    {
+        for (size_t i = 0; i < sequence.size(); ++i)
+        {
+            std::vector<std::pair<double, size_t>> scores;
+            for (size_t j = 0; j < sequence.size(); ++j)
+            {
+                if (j + window >= i && j <= i + window)
+                    continue;
+
+                const double score = Similarity(sequence[i].left, sequence[j].left);
+                if (score > 0)
+                    scores.emplace_back(score, j);
+            }
+
+            const size_t count = std::min(scores.size(), static_cast<size_t>(retrieval_count));
+            std::partial_sort(scores.begin(), scores.begin() + count, scores.end(),
+                              [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                                  return a.first > b.first;
+                              });
+            for (size_t k = 0; k < count; ++k)
+                AddFramePairs(sequence[i], sequence[scores[k].second], pairs);
+        }
+    }
+
+    for (const auto id : unparsed)
+    {
+        for (const auto& view : sfm_data.GetViews())
+            AddPair(id, view.first, pairs);
+    }
+
+    return pairs;
+}
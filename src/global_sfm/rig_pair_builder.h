@@ -0,0 +1,52 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+#include <openMVG/sfm/sfm_data.hpp>
+#include <openMVG/types.hpp>
+#include <opencv2/core.hpp>
+
+// match pairs for a stereo rig shot in sequence, views named <left_prefix><frame> / <right_prefix><frame>.
+// each view is paired with its rig partner and with both sides of the frames within window,
+// retrieval adds the most similar frames outside the window by thumbnail correlation.
+// views whose name doesn't parse are paired with every view
+class RigPairBuilder
+{
+public:
+    RigPairBuilder(const std::string& left_prefix, const std::string& right_prefix,
+                   int window, int retrieval_count);
+
+    // needed for every left view when retrieval_count > 0
+    void AddThumbnail(openMVG::IndexT view_id, const cv::Mat& img);
+
+    openMVG::Pair_Set Build(const openMVG::sfm::SfM_Data& sfm_data) const;
+
+    // (left, right) views shot together by the rig
+    std::vector<std::pair<openMVG::IndexT, openMVG::IndexT>> Partners(const openMVG::sfm::SfM_Data& sfm_data) const;
+
+    // identifies the pair selection, for cache keys
+    std::string Tag() const;
+
+private:
+    struct RigFrame
+    {
+        openMVG::IndexT left = openMVG::UndefinedIndexT;
+        openMVG::IndexT right = openMVG::UndefinedIndexT;
+    };
+
+    // rig frames in capture order, views whose name doesn't parse go to unparsed
+    std::vector<RigFrame> Sequence(const openMVG::sfm::SfM_Data& sfm_data,
+                                   std::vector<openMVG::IndexT>* unparsed = nullptr) const;
+    void AddFramePairs(const RigFrame& a, const RigFrame& b, openMVG::Pair_Set& pairs) const;
+    double Similarity(openMVG::IndexT a, openMVG::IndexT b) const;
+
+private:
+    const std::string left_prefix;
+    const std::string right_prefix;
+    const int window;
+    const int retrieval_count;
+
+    // zero mean, unit norm thumbnails
+    std::map<openMVG::IndexT, cv::Mat> thumbnails;
+};
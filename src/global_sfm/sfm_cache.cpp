@@ -0,0 +1,142 @@
+#include "sfm_cache.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <openMVG/matching/indMatch_utils.hpp>
+#include <third_party/stlplus3/filesystemSimplified/file_system.hpp>
+
+namespace
+{
+// 64 bit FNV-1a
+constexpr uint64_t fnv_offset = 14695981039346656037ULL;
+constexpr uint64_t fnv_prime = 1099511628211ULL;
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+
+// writers go through a temporary name so an interrupted run never leaves a truncated entry
+bool Commit(const std::string& tmp_path, const std::string& path)
+{
+    if (std::rename(tmp_path.c_str(), path.c_str()) == 0)
+        return true;
+
+    std::remove(tmp_path.c_str());
+    return false;
+}
+} // namespace
+
+SfMCache::SfMCache(const std::string& cache_dir)
+    : cache_dir(cache_dir)
+    , valid(stlplus::folder_exists(cache_dir) || stlplus::folder_create(cache_dir))
+{
+}
+
+SfMCache::Key SfMCache::HashImage(const cv::Mat& img)
+{
+    const int header[] = {img.rows, img.cols, img.type()};
+    Key hash = Fnv1a(fnv_offset, header, sizeof(header));
+
+    const size_t row_bytes = img.cols * img.elemSize();
+    for (int v = 0; v < img.rows; ++v)
+        hash = Fnv1a(hash, img.ptr(v), row_bytes);
+
+    return hash;
+}
+
+SfMCache::Key SfMCache::HashFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    Key hash = fnv_offset;
+
+    char buf[1 << 16];
+    while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+        hash = Fnv1a(hash, buf, static_cast<size_t>(in.gcount()));
+
+    return hash;
+}
+
+SfMCache::Key SfMCache::Combine(Key key, const std::string& tag)
+{
+    return Fnv1a(Fnv1a(fnv_offset, &key, sizeof(key)), tag.data(), tag.size());
+}
+
+SfMCache::Key SfMCache::Combine(Key key, const std::vector<Key>& keys)
+{
+    return Fnv1a(Fnv1a(fnv_offset, &key, sizeof(key)), keys.data(), keys.size() * sizeof(Key));
+}
+
+std::string SfMCache::Path(Key key, const std::string& ext) const
+{
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return stlplus::create_filespec(cache_dir, name, ext);
+}
+
+bool SfMCache::LoadRegions(Key key, openMVG::features::Regions& regions) const
+{
+    if (!valid)
+        return false;
+
+    const auto feat_path = Path(key, "feat");
+    const auto desc_path = Path(key, "desc");
+    if (!stlplus::file_exists(feat_path) || !stlplus::file_exists(desc_path))
+        return false;
+
+    return regions.Load(feat_path, desc_path);
+}
+
+bool SfMCache::SaveRegions(Key key, const openMVG::features::Regions& regions) const
+{
+    if (!valid)
+        return false;
+
+    // desc first, LoadRegions needs both and the feat file marks the entry complete
+    const auto feat_path = Path(key, "feat");
+    const auto desc_path = Path(key, "desc");
+    if (!regions.Save(feat_path + ".tmp", desc_path + ".tmp"))
+    {
+        std::remove((feat_path + ".tmp").c_str());
+        std::remove((desc_path + ".tmp").c_str());
+        return false;
+    }
+
+    return Commit(desc_path + ".tmp", desc_path) && Commit(feat_path + ".tmp", feat_path);
+}
+
+bool SfMCache::LoadMatches(Key key, openMVG::matching::PairWiseMatches& matches) const
+{
+    if (!valid)
+        return false;
+
+    const auto path = Path(key, "bin");
+    if (!stlplus::file_exists(path))
+        return false;
+
+    return openMVG::matching::Load(matches, path);
+}
+
+bool SfMCache::SaveMatches(Key key, const openMVG::matching::PairWiseMatches& matches) const
+{
+    if (!valid)
+        return false;
+
+    // the extension picks the binary serializer
+    const auto path = Path(key, "bin");
+    const auto tmp_path = stlplus::create_filespec(cache_dir, stlplus::basename_part(path) + ".tmp", "bin");
+    if (!openMVG::matching::Save(matches, tmp_path))
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return Commit(tmp_path, path);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <openMVG/features/regions.hpp>
+#include <openMVG/matching/indMatch.hpp>
+#include <opencv2/core.hpp>
+
+// on-disk cache of regions and pairwise matches,
+// entries are named by a content hash so changed images or params simply miss
+class SfMCache
+{
+public:
+    using Key = uint64_t;
+
+    explicit SfMCache(const std::string& cache_dir);
+
+    // false when the cache folder can't be created, every lookup misses then
+    bool Valid() const { return valid; }
+
+    static Key HashImage(const cv::Mat& img);
+    static Key HashFile(const std::string& path);
+    static Key Combine(Key key, const std::string& tag);
+    static Key Combine(Key key, const std::vector<Key>& keys);
+
+    bool LoadRegions(Key key, openMVG::features::Regions& regions) const;
+    bool SaveRegions(Key key, const openMVG::features::Regions& regions) const;
+
+    bool LoadMatches(Key key, openMVG::matching::PairWiseMatches& matches) const;
+    bool SaveMatches(Key key, const openMVG::matching::PairWiseMatches& matches) const;
+
+private:
+    std::string Path(Key key, const std::string& ext) const;
+
+private:
+    const std::string cache_dir;
+    bool valid;
+};
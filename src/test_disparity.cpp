@@ -1,20 +1,163 @@
 #include "disparity_display.h"
+#include "model_generator/stream/stereo_stream.h"
+#include "model_processor/filter/outlier_filter.h"
+#include "model_processor/filter/budget_filter.h"
+#include "model_processor/filter/voxel_filter.h"
+#include "model_processor/odometry/stereo_odometry.h"
+#include "model_processor/organized/organized_normal.h"
+#include "profiling/tracked_mat_allocator.h"
+#include "profiling/trace.h"
 #include <iostream>
+#include <mutex>
 
 int main(int argc, char** argv)
 {
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
+    TrackedMatAllocator::Install();
     glutInit(&argc, argv);
 
     auto sgbm_solver = SgbmSolver("/home/ospacer/Documents/resource",
                                   "/map",
                                   "/images/heart_model2/left",
                                   "/images/heart_model2/right");
+
+    // usage: test_disparity [left_folder right_folder | stereo_video]
+    const bool streaming = argc > 1;
+
     WinBoundary win_bound;
-    auto model = sgbm_solver.Solve("left_1.png", "right_1.png", win_bound);
-    std::cout << "model vertex count:" << model.size() << std::endl;
+    Model model;
+    StereoFrame full_frame;
+    if (!streaming)
+    {
+        model = sgbm_solver.Solve("left_1.png", "right_1.png", win_bound, &full_frame);
+        std::cout << "model vertex count:" << model.size() << std::endl;
+        sgbm_solver.Save(full_frame, "model.rgbd");
+
+        // grid normals come from the pixel neighbours, the points stretched across
+        // depth jumps face away from the camera and are dropped before the unordered filter
+        WinBoundary grid_bound;
+        OrganizedModel organized = sgbm_solver.ReprojectOrganized(full_frame, grid_bound);
+        ComputeGridNormals(organized, 1.0);
+        const size_t grazing = DropGrazingVertex(organized, 0.2);
+        model = organized.ToModel();
+        std::cout << "grid normals: dropped " << grazing << " grazing vertex, " << model.size() << " left\n";
+
+        // speckle left by the depth range check
+        FilterReport report;
+        win_bound = WinBoundary();
+        model = StatisticalOutlierFilter(16, 2.0, 0.2).Filter(model, win_bound, &report);
+        const double mpts_per_s = report.elapsed_ms > 0 ? report.input_count / report.elapsed_ms / 1000.0 : 0.0;
+        std::cout << "outlier filter: " << report.input_count << " -> " << report.output_count
+                  << " in " << report.elapsed_ms << " ms (" << mpts_per_s << " Mpts/s)\n";
+    }
 
     auto viewer = GlWindow("display");
-    viewer.SetBoundaryBox(win_bound);
+    if (!streaming)
+    {
+        viewer.SetBoundaryBox(win_bound);
+        viewer.SetRefineFunc([&](const std::vector<Eigen::Vector3d>& box_vertex) {
+            const cv::Rect roi = sgbm_solver.RegionOf(box_vertex);
+            WinBoundary region_bound;
+            auto region_model = sgbm_solver.SolveRegion("left_1.png", "right_1.png", roi,
+                                                        sgbm_solver.RegionParams(),
+                                                        full_frame, region_bound);
+            sgbm_solver.Splice(model, region_model, roi);
+            std::cout << "refined region " << roi << ", model vertex count:" << model.size() << std::endl;
+        });
+    }
+
+    StereoStream stream(sgbm_solver);
+    std::mutex stream_mtx;
+    Model stream_model; // points the viewer hasn't taken yet
+    WinBoundary stream_bound;
+    bool stream_fresh = false;
+    bool stream_replace = false; // stream_model is the whole compacted cloud
+    bool first_frame = true;
+    StereoOdometry odometry(sgbm_solver.Camera(), sgbm_solver.Baseline());
+    Model world_model;
+    WinBoundary world_bound;
+    size_t compact_size = 0;
+    if (streaming)
+    {
+        bool opened = argc > 2 ? stream.OpenFolders(argv[1], argv[2])
+                               : stream.OpenVideo(argv[1]);
+        if (!opened)
+        {
+            std::cout << "open stereo stream fail\n";
+            return EXIT_FAILURE;
+        }
+
+        // frames are placed in the first frame's camera as they arrive,
+        // frames odometry loses are dropped rather than merged at a stale pose
+        stream.SetPoseFunc([&](const StereoFrame& frame, Eigen::Isometry3d& pose) {
+            OdometryReport report;
+            const bool tracked = odometry.Track(frame.left, frame.right, &report);
+            std::cout << "odometry: " << report.inliers << " / " << report.tracked << " inliers in "
+                      << report.elapsed_ms << " ms" << (tracked ? "\n" : ", lost\n");
+
+            pose = odometry.Pose();
+            return tracked;
+        });
+
+        // each frame is thinned on its own and appended, the whole cloud is only
+        // re-gridded once it doubled, so a frame costs its own points amortized.
+        // the grid gets coarser once over MEMORY_BUDGET_MB
+        stream.Start([&](Model&& frame_model, const WinBoundary&) {
+            WinBoundary frame_bound;
+            Model thinned = VoxelFilter(0.2).Filter(frame_model, frame_bound);
+            world_model.insert(world_model.end(), thinned.begin(), thinned.end());
+            world_bound.Extend(frame_bound);
+
+            bool compacted = false;
+            if (compact_size == 0)
+            {
+                compact_size = world_model.size();
+            }
+            else if (world_model.size() >= 2 * compact_size)
+            {
+                world_bound = WinBoundary();
+                world_model = BudgetFilter(0.2).Filter(world_model, world_bound);
+                compact_size = std::max<size_t>(1, world_model.size());
+                compacted = true;
+            }
+
+            std::lock_guard<std::mutex> lock(stream_mtx);
+            if (compacted)
+            {
+                stream_model = world_model;
+                stream_replace = true;
+            }
+            else
+            {
+                stream_model.insert(stream_model.end(), thinned.begin(), thinned.end());
+            }
+            stream_bound = world_bound;
+            stream_fresh = true;
+        });
+
+        viewer.SetUpdateFunc([&]() {
+            std::lock_guard<std::mutex> lock(stream_mtx);
+            if (!stream_fresh)
+                return false;
+
+            if (stream_replace)
+                model.swap(stream_model);
+            else
+                model.insert(model.end(), stream_model.begin(), stream_model.end());
+            stream_model.clear();
+            stream_fresh = false;
+            stream_replace = false;
+            std::cout << "model vertex count:" << model.size() << std::endl;
+            if (first_frame)
+            {
+                viewer.SetBoundaryBox(stream_bound);
+                first_frame = false;
+            }
+            return true;
+        });
+    }
+
     viewer.SetDrawFrameFunc([&model]() {
         glPointSize(2.0);
         glBegin(GL_POINTS);
@@ -1,23 +1,52 @@
+#include "global_sfm/dense_reconstructor.h"
 #include "global_sfm/global_sfm.h"
 #include "ply_display.h"
+#include "profiling/tracked_mat_allocator.h"
+#include "profiling/trace.h"
 #include <iostream>
 
+// usage: test_global_sfm [dense]
 int main(int argc, char** argv)
 {
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
+    TrackedMatAllocator::Install();
     glutInit(&argc, argv);
+    const bool dense = argc > 1 && std::string(argv[1]) == "dense";
 
     const std::string images_dir = "/home/ospacer/Documents/3d/project/file/image7/images/";
     const std::string output_dir = "../output/";
     auto solver = GlobalSfM(images_dir, output_dir);
+    solver.SetExportPly(false);
+    solver.SetKeepStereoPairs(dense);
     if (!solver.Solve())
     {
         std::cout << "--- global sfm solve fail ---\n";
         return EXIT_FAILURE;
     }
 
-    auto loader = PlyLoader(solver.GetModelPath());
-    WinBoundary bound;
-    auto model = loader.Load(bound);
+    Model model = solver.GetModel();
+    WinBoundary bound = solver.GetBoundary();
+    if (dense)
+    {
+        // stage methods only, the pairs come rectified from the sfm run
+        auto sgbm_solver = SgbmSolver("/home/ospacer/Documents/resource",
+                                      "/map",
+                                      "/images/heart_model2/left",
+                                      "/images/heart_model2/right");
+
+        // fused depth stops where the disparity drops under 4 px
+        sgbm_solver.SetMinMetricDisparity(4.0);
+        DenseParams dense_params;
+        dense_params.min_depth = sgbm_solver.MetricMinDepth();
+        dense_params.max_depth = sgbm_solver.MetricMaxDepth();
+
+        DenseReport report;
+        bound = WinBoundary();
+        model = DenseReconstructor(sgbm_solver, dense_params).Reconstruct(solver.GetStereoPairs(), bound, &report);
+        std::cout << "dense: " << report.pairs.size() << " pairs in " << report.elapsed_s << " s ("
+                  << report.pairs_per_s << " pairs/s)\n";
+    }
     std::cout << "model vertex count:" << model.size() << std::endl;
 
     auto viewer = GlWindow("global_sfm_display");
@@ -0,0 +1,91 @@
+#include "model_generator/rgbd/rgbd_file.h"
+#include "model_processor/mesh/grid_mesher.h"
+#include "ply_display.h"
+#include "profiling/memory_tracker.h"
+#include "profiling/trace.h"
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
+    glutInit(&argc, argv);
+
+    // usage: test_mesh [model.rgbd] [max_cell]
+    const std::string model_path = argc > 1 ? argv[1] : "model.rgbd";
+    const int max_cell = argc > 2 ? std::stoi(argv[2]) : 16;
+
+    WinBoundary bound;
+    auto organized = RgbdLoader(model_path).LoadOrganized(bound);
+    std::cout << "organized model: " << organized.width << "x" << organized.height
+              << ", valid vertex count:" << organized.ValidCount() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    bound = WinBoundary();
+    auto mesh = GridMesher(0.05, max_cell).Triangulate(organized, bound);
+    std::cout << "mesh vertex count:" << mesh.vertex.size() << ", face count:" << mesh.face.size()
+              << " in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms" << std::endl;
+
+    const Model& model = mesh.vertex;
+    auto viewer = GlWindow("mesh_display");
+    viewer.SetBoundaryBox(bound);
+    viewer.SetDrawFrameFunc([&mesh]() {
+        glDisable(GL_CULL_FACE);
+        glBegin(GL_TRIANGLES);
+        for (const auto& face : mesh.face)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                const auto& vertex = mesh.vertex[face(i)];
+                glColor3d(vertex.color.r / 255.0, vertex.color.g / 255.0, vertex.color.b / 255.0);
+                glVertex3d(vertex.pos.x(), vertex.pos.y(), vertex.pos.z());
+            }
+        }
+        glEnd();
+        glEnable(GL_CULL_FACE);
+    });
+
+    viewer.SetRectBoxFunc([&model](int x1, int y1, int x2, int y2) {
+        std::vector<Eigen::Vector3d> selected;
+
+        GLProjector projector;
+        for (const auto& vertex : model)
+        {
+            Eigen::Vector3d pixel_pos = projector.Project(vertex.pos);
+            if (pixel_pos.x() > std::min(x1, x2) &&
+                pixel_pos.x() < std::max(x1, x2) &&
+                pixel_pos.y() > std::min(y1, y2) &&
+                pixel_pos.y() < std::max(y1, y2))
+            {
+                selected.push_back(vertex.pos);
+            }
+        }
+
+        return selected;
+    });
+
+    viewer.SetCurveFunc([&model](int x, int y) {
+        Eigen::Vector3d res = Eigen::Vector3d::Zero();
+        double dis_min = 1e10;
+
+        GLProjector projector;
+        for (const auto& vertex : model)
+        {
+            Eigen::Vector3d pixel_pos = projector.Project(vertex.pos);
+            double dis = sqrt(pow((pixel_pos.x() - x), 2) +
+                              pow((pixel_pos.y() - y), 2));
+            if (dis < 3.0)
+            {
+                dis_min = std::min(dis_min, dis);
+                res = vertex.pos;
+            }
+        }
+
+        return res;
+    });
+
+    glutMainLoop();
+    return 0;
+}
@@ -1,17 +1,45 @@
+#include "model_generator/rgbd/rgbd_file.h"
+#include "model_processor/filter/voxel_filter.h"
 #include "ply_display.h"
+#include "profiling/memory_tracker.h"
+#include "profiling/trace.h"
 #include <iostream>
 
 int main(int argc, char** argv)
 {
+    Tracer::InitFromEnv();
+    MemoryTracker::InitFromEnv();
     glutInit(&argc, argv);
 
+    // usage: test_ply [model.ply | model.rgbd] [voxel_leaf_size]
     const std::string work_path = "/home/ospacer/Documents/sfm_project/";
-    auto loader = PlyLoader(work_path + "model_ply/model_dense.ply");
-    std::cout << "PlyLoader success\n";
+    const std::string model_path = argc > 1 ? argv[1] : work_path + "model_ply/model_dense.ply";
+    const bool is_rgbd = model_path.size() > 5 &&
+                         model_path.compare(model_path.size() - 5, 5, ".rgbd") == 0;
+
     WinBoundary bound;
-    auto model = loader.Load(bound);
+    Model model;
+    if (is_rgbd)
+    {
+        model = RgbdLoader(model_path).Load(bound);
+    }
+    else
+    {
+        auto loader = PlyLoader(model_path);
+        std::cout << "PlyLoader success\n";
+        model = loader.Load(bound);
+    }
     std::cout << "model vertex count:" << model.size() << std::endl;
 
+    if (argc > 2)
+    {
+        FilterReport report;
+        bound = WinBoundary();
+        model = VoxelFilter(std::stod(argv[2])).Filter(model, bound, &report);
+        std::cout << "voxel filter: " << report.input_count << " -> " << report.output_count
+                  << " (" << report.ratio * 100 << "%) in " << report.elapsed_ms << " ms\n";
+    }
+
     auto viewer = GlWindow("display");
     viewer.SetBoundaryBox(bound);
     viewer.SetDrawFrameFunc([&model]() {